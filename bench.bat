@@ -0,0 +1,11 @@
+@echo off
+
+pushd bin\
+
+cl.exe /nologo /diagnostics:caret /W4 /WX /wd4100 /O2 /GR- /EHa- /MT /FC /D_CRT_SECURE_NO_WARNINGS ..\src\bench.c /link /incremental:no /out:varia_bench.exe || exit /b 1
+
+REM The benchmarks' own output isn't interesting.
+varia_bench bench.json > nul
+
+popd
+exit /b %errorlevel%
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+cd bin/ || exit 1
+
+cc -std=gnu11 -O2 -Wall -Wextra -Werror -Wno-unused-parameter -Wno-switch ../src/bench.c -o varia_bench || exit 1
+
+# The benchmarks' own output isn't interesting.
+./varia_bench bench.json > /dev/null
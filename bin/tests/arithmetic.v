@@ -0,0 +1,58 @@
+// Integer arithmetic, worked out at run time and folded as constants.
+// Ints wrap around when they overflow, and x / -1 never traps.
+
+add :: (a: int, b: int) -> int {
+    return a + b;
+}
+
+subtract :: (a: int, b: int) -> int {
+    return a - b;
+}
+
+multiply :: (a: int, b: int) -> int {
+    return a * b;
+}
+
+negate :: (a: int) -> int {
+    return -a;
+}
+
+divide :: (a: int, b: int) -> int {
+    return a / b;
+}
+
+main :: () {
+    max := 9223372036854775807;
+    min := -9223372036854775807 - 1;
+    
+    // Called enough times for the JIT to compile them.
+    i := 0;
+    while i < 20 {
+        print(add(i, 1) + subtract(i, 1) + multiply(i, 2) + negate(i) + divide(i, 3));
+        i = i + 1;
+    }
+    
+    print(add(max, 1));
+    print(subtract(min, 1));
+    print(multiply(max, 2));
+    print(multiply(min, -1));
+    print(negate(min));
+    print(max + 1);
+    print(min - 1);
+    
+    print(9223372036854775807 + 1);
+    print(-9223372036854775807 - 2);
+    print(9223372036854775807 * 3);
+    print(-(-9223372036854775807 - 1));
+    
+    print(7 / 2);
+    print(-7 / 2);
+    print(7 / -2);
+    print((-9223372036854775807 - 1) / -1);
+    print(divide(7, 2));
+    print(divide(-7, 2));
+    print(divide(7, -2));
+    print(divide(min, -1));
+    print(divide(min, 1));
+    print(divide(5, -1));
+}
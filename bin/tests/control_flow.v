@@ -0,0 +1,79 @@
+// if/else chains, nested while loops and every comparison.
+// The helpers are called often enough to be compiled by the JIT.
+
+sign :: (n: int) -> int {
+    if n < 0 {
+        return -1;
+    } else if n == 0 {
+        return 0;
+    }
+    return 1;
+}
+
+compare :: (a: int, b: int) -> int {
+    result := 0;
+    if a == b { result = result + 1; }
+    if a != b { result = result + 2; }
+    if a < b { result = result + 4; }
+    if a <= b { result = result + 8; }
+    if a > b { result = result + 16; }
+    if a >= b { result = result + 32; }
+    return result;
+}
+
+compare_floats :: (a: float, b: float) -> int {
+    return (a == b) + (a != b)*2 + (a < b)*4 + (a <= b)*8 + (a > b)*16 + (a >= b)*32;
+}
+
+// Counts the pairs (i, j) with 0 <= j < i < n.
+triangle :: (n: int) -> int {
+    count := 0;
+    i := 0;
+    while i < n {
+        j := 0;
+        while j < i {
+            count = count + 1;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return count;
+}
+
+main :: () {
+    i := -3;
+    while i <= 3 {
+        print(sign(i));
+        i = i + 1;
+    }
+    
+    a := -2;
+    while a <= 2 {
+        b := -2;
+        while b <= 2 {
+            print(compare(a, b));
+            b = b + 2;
+        }
+        a = a + 2;
+    }
+    
+    print(compare_floats(0.5, 1.5));
+    print(compare_floats(1.5, 1.5));
+    print(compare_floats(2.5, 1.5));
+    print(compare_floats(-0.0, 0.0));
+    
+    n := 0;
+    while n < 20 {
+        print(triangle(n));
+        n = n + 5;
+    }
+    print(triangle(1000));
+    
+    if 0 {
+        print("not taken\n");
+    } else if 1 - 1 {
+        print("not taken either\n");
+    } else {
+        print("else\n");
+    }
+}
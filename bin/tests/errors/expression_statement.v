@@ -0,0 +1,5 @@
+main :: () {
+    x := 1;
+    x + 1;
+    print(x);
+}
@@ -0,0 +1,8 @@
+main :: () {
+    print(1);
+    x := 2
+}
+
+other :: () {
+    print(2);
+}
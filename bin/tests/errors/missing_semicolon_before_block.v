@@ -0,0 +1,9 @@
+// The block isn't part of the statement before it, so it's the missing
+// ; that's reported, not y, and on the line it's missing from.
+main :: () {
+    x := 1
+    {
+        y := 2;
+        print(y);
+    }
+}
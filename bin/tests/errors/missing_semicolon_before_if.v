@@ -0,0 +1,7 @@
+main :: () {
+    x := 3;
+    x = x + 1
+    if x > 3 {
+        print(x);
+    }
+}
@@ -0,0 +1,4 @@
+main :: () {
+    print(1);
+    5;
+}
@@ -0,0 +1,53 @@
+// Every call takes more than 300 bytes of stack, so 60000 of them fit in
+// the default heap, but not in an 8MB one.
+
+down :: (n: int) -> int {
+    v0 := n;
+    v1 := v0 + 1;
+    v2 := v1 + 1;
+    v3 := v2 + 1;
+    v4 := v3 + 1;
+    v5 := v4 + 1;
+    v6 := v5 + 1;
+    v7 := v6 + 1;
+    v8 := v7 + 1;
+    v9 := v8 + 1;
+    v10 := v9 + 1;
+    v11 := v10 + 1;
+    v12 := v11 + 1;
+    v13 := v12 + 1;
+    v14 := v13 + 1;
+    v15 := v14 + 1;
+    v16 := v15 + 1;
+    v17 := v16 + 1;
+    v18 := v17 + 1;
+    v19 := v18 + 1;
+    v20 := v19 + 1;
+    v21 := v20 + 1;
+    v22 := v21 + 1;
+    v23 := v22 + 1;
+    v24 := v23 + 1;
+    v25 := v24 + 1;
+    v26 := v25 + 1;
+    v27 := v26 + 1;
+    v28 := v27 + 1;
+    v29 := v28 + 1;
+    v30 := v29 + 1;
+    v31 := v30 + 1;
+    v32 := v31 + 1;
+    v33 := v32 + 1;
+    v34 := v33 + 1;
+    v35 := v34 + 1;
+    v36 := v35 + 1;
+    v37 := v36 + 1;
+    v38 := v37 + 1;
+    v39 := v38 + 1;
+    if n == 0 {
+        return 0;
+    }
+    return down(n - 1) + v39 - n - 38;
+}
+
+main :: () {
+    print(down(60000));
+}
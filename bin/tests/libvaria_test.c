@@ -0,0 +1,143 @@
+// Checks that libvaria reports errors instead of exiting, and that an
+// interpreter can still be used after any of them. test.sh builds it
+// with src/libvaria.c and runs it, and it prints what went wrong, if
+// anything did.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "varia.h"
+
+struct Output {
+    char data[4096];
+    size_t length;
+};
+
+static int failures;
+
+static void
+output_write(void *data, const char *text, uint64_t size) {
+    struct Output *output = data;
+    if (output->length + size >= sizeof(output->data)) {
+        size = sizeof(output->data) - output->length - 1;
+    }
+    memcpy(output->data + output->length, text, size);
+    output->length += size;
+    output->data[output->length] = 0;
+}
+
+static void
+expect(bool ok, const char *what, const char *got) {
+    if (!ok) {
+        __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+        fprintf(stderr, "libvaria %s, but got:\n%s\n", what, got);
+    }
+}
+
+// Loads source and checks that it fails with an error that has want in it.
+static void
+expect_load_error(struct Varia *varia, const char *source, const char *want) {
+    bool loaded = varia_load(varia, "bad.v", source, strlen(source));
+    expect(!loaded && strstr(varia_error(varia), want), want, varia_error(varia));
+}
+
+static const char *good =
+    "fib :: (n: int) -> int { if n < 2 { return n; } return fib(n-1) + fib(n-2); }\n"
+    "main :: () { print(fib(20)); print(\"done\\n\"); }\n";
+
+static const char *divide =
+    "f :: (a: int) -> int { return 10 / a; }\n"
+    "main :: () { print(1); print(f(0)); }\n";
+
+static const char *deep =
+    "r :: (n: int) -> int { return r(n+1) + 1; }\n"
+    "main :: () { print(r(0)); }\n";
+
+// Loads and runs good, and checks what it printed.
+static void
+expect_good(struct Varia *varia, struct Output *output, const char *what) {
+    output->length = 0;
+    output->data[0] = 0;
+    bool ok = varia_load(varia, "good.v", good, strlen(good)) && varia_run(varia);
+    expect(ok, what, varia_error(varia));
+    expect(strcmp(output->data, "6765\ndone\n") == 0, what, output->data);
+}
+
+// Everything that can go wrong, in turn, on one interpreter.
+static void *
+run_everything(void *no_jit) {
+    struct Output output = {0};
+    struct Varia_Options options = {0};
+    options.write = output_write;
+    options.write_data = &output;
+    options.no_jit = no_jit != NULL;
+    options.heap_size = 8 << 20;
+    struct Varia *varia = varia_create(&options);
+    expect(varia != NULL, "couldn't create an interpreter", "");
+    if (!varia) return NULL;
+
+    expect(!varia_run(varia) && strstr(varia_error(varia), "no program"),
+           "ran without a program", varia_error(varia));
+
+    expect_good(varia, &output, "didn't run a program");
+
+    // Running it again starts it over.
+    output.length = 0;
+    expect(varia_run(varia) && strcmp(output.data, "6765\ndone\n") == 0, "didn't run a program again", output.data);
+
+    // Compile errors throw the program away, and say where they are.
+    const char *undefined = "main :: () {\n    x := y;\n}\n";
+    expect(!varia_load(varia, "bad.v", undefined, strlen(undefined)) &&
+           strcmp(varia_error(varia), "Error: bad.v(2)\n  y is not defined\n") == 0,
+           "didn't report an undefined variable", varia_error(varia));
+    expect(!varia_run(varia), "ran a program that didn't compile", "");
+    expect_load_error(varia, "main :: () {\n    print(1);\n", "never closed");
+    expect_load_error(varia, "main :: () {\n    print(1)\n}\n", "Expected a ;");
+    expect_load_error(varia, "main :: () {\n    x := 1;\n    x + 1;\n}\n", "Expected a : or an =");
+    expect_good(varia, &output, "didn't load after compile errors");
+
+    // Runtime errors keep the program, and what it printed before them.
+    output.length = 0;
+    expect(varia_load(varia, "divide.v", divide, strlen(divide)), "didn't load divide.v", varia_error(varia));
+    expect(!varia_run(varia) && strstr(varia_error(varia), "Division by zero in f()"),
+           "didn't report dividing by zero", varia_error(varia));
+    expect(strcmp(output.data, "1\n") == 0, "lost the output from before an error", output.data);
+    expect(!varia_run(varia) && strstr(varia_error(varia), "Division by zero in f()"),
+           "didn't run a program again after an error", varia_error(varia));
+
+    expect(varia_load(varia, "deep.v", deep, strlen(deep)), "didn't load deep.v", varia_error(varia));
+    expect(!varia_run(varia) && strstr(varia_error(varia), "Stack overflow in r()"),
+           "didn't report a stack overflow", varia_error(varia));
+    expect(!varia_run(varia) && strstr(varia_error(varia), "Stack overflow in r()"),
+           "didn't overflow the stack again", varia_error(varia));
+    expect_good(varia, &output, "didn't load after runtime errors");
+
+    varia_destroy(varia);
+    return NULL;
+}
+
+int
+main(void) {
+    // A heap that's too small is an error when a program's loaded.
+    struct Varia_Options options = {0};
+    options.heap_size = 1 << 20;
+    struct Varia *varia = varia_create(&options);
+    expect_load_error(varia, good, "has to be at least");
+    varia_destroy(varia);
+
+    run_everything(NULL);
+    run_everything("no jit");
+
+    // Interpreters on different threads don't get in each other's way.
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, run_everything, i & 1 ? "no jit" : NULL);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return failures != 0;
+}
@@ -0,0 +1,27 @@
+// What print() writes for each type. Strings go out as they are, and
+// ints and floats get a newline after them.
+
+main :: () {
+    print("strings go out as they are, ");
+    print("with no newline\n");
+    print("");
+    print("escapes:\ta\\b\n");
+    short := "short";
+    long := "a string too long to be kept inline in a value\n";
+    print(short);
+    print(long);
+    
+    print(0);
+    print(-1);
+    print(1234567890123);
+    print(-9223372036854775807 - 1);
+    print(9223372036854775807);
+    
+    print(0.0);
+    print(-2.5);
+    print(1.0 / 3.0);
+    print(100000000.0 * 100000000.0);
+    print(0.000001);
+    print(7.0 / 2.0 * 2.0);
+    print(-0.0000004);
+}
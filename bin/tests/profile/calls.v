@@ -0,0 +1,15 @@
+// Calls the same functions from different places, so each call stack
+// is counted on its own.
+
+leaf :: (n: int) -> int { return n + 1; }
+mid :: (n: int) -> int { return leaf(n) + leaf(n); }
+top :: () -> int { return mid(1) + leaf(2); }
+
+main :: () {
+    i := 0;
+    while i < 100 {
+        top();
+        i = i + 1;
+    }
+    print(mid(5));
+}
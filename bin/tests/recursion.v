@@ -0,0 +1,68 @@
+// Recursion, deep enough that the JIT compiles the functions and calls
+// back and forth between them and the interpreter.
+
+fib :: (n: int) -> int {
+    if n < 2 {
+        return n;
+    }
+    return fib(n-1) + fib(n-2);
+}
+
+// Ackermann's function, for calls nested in arguments.
+ack :: (m: int, n: int) -> int {
+    if m == 0 {
+        return n + 1;
+    }
+    if n == 0 {
+        return ack(m - 1, 1);
+    }
+    return ack(m - 1, ack(m, n - 1));
+}
+
+is_even :: (n: int) -> int {
+    if n == 0 {
+        return 1;
+    }
+    return is_odd(n - 1);
+}
+
+is_odd :: (n: int) -> int {
+    if n == 0 {
+        return 0;
+    }
+    return is_even(n - 1);
+}
+
+sum_to :: (n: int) -> int {
+    if n == 0 {
+        return 0;
+    }
+    return n + sum_to(n - 1);
+}
+
+power :: (x: float, n: int) -> float {
+    if n == 0 {
+        return 1.0;
+    }
+    half := power(x, n / 2);
+    if n - n/2*2 == 1 {
+        return half * half * x;
+    }
+    return half * half;
+}
+
+main :: () {
+    n := 0;
+    while n <= 25 {
+        print(fib(n));
+        n = n + 5;
+    }
+    print(ack(2, 3));
+    print(ack(3, 3));
+    print(is_even(1001));
+    print(is_odd(1001));
+    print(sum_to(5000));
+    print(power(2.0, 10));
+    print(power(1.5, 7));
+    print(power(0.5, 3));
+}
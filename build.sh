@@ -0,0 +1,5 @@
+#!/bin/sh
+
+cd bin/ || exit 1
+
+cc -std=gnu11 -g -O0 -fsanitize=address -Wall -Wextra -Werror -Wno-unused-parameter -Wno-switch ../src/main.c -o varia
@@ -0,0 +1,12 @@
+@echo off
+
+pushd bin\
+
+REM libvaria.lib to link in statically, and libvaria.dll, which only
+REM exports what's in src\varia.h.
+cl.exe /nologo /diagnostics:caret /W4 /WX /wd4100 /O2 /GR- /EHa- /MT /FC /D_CRT_SECURE_NO_WARNINGS /c ..\src\libvaria.c /Folibvaria.obj || exit /b 1
+lib.exe /nologo libvaria.obj /out:libvaria.lib || exit /b 1
+
+cl.exe /nologo /diagnostics:caret /W4 /WX /wd4100 /O2 /GR- /EHa- /MT /FC /D_CRT_SECURE_NO_WARNINGS /DVARIA_DLL_EXPORT /LD ..\src\libvaria.c /Folibvaria_dll.obj /link /incremental:no /implib:libvaria_dll.lib /out:libvaria.dll
+
+exit /b %errorlevel%
@@ -0,0 +1,17 @@
+#!/bin/sh
+
+# Builds libvaria, the interpreter as a library for other programs to
+# run Varia programs with: bin/libvaria.a and bin/libvaria.so. See
+# src/varia.h for how to use it.
+
+cd bin/ || exit 1
+
+cc -std=gnu11 -O2 -fPIC -fvisibility=hidden -Wall -Wextra -Werror -Wno-unused-parameter -Wno-switch -c ../src/libvaria.c -o libvaria.o || exit 1
+
+# Only what's in varia.h is exported. Everything else is made local, so
+# it can't clash with anything in the program the library is linked into.
+objcopy --localize-hidden libvaria.o || exit 1
+
+rm -f libvaria.a
+ar rcs libvaria.a libvaria.o || exit 1
+cc -shared libvaria.o -o libvaria.so
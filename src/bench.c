@@ -0,0 +1,319 @@
+// Generates a few kinds of programs, runs each one through the
+// tokenizer and the interpreter, and writes how fast that was to
+// a JSON file, so we can compare between versions. Built by bench.sh.
+//
+// Whatever the programs print goes to stdout, so send that somewhere.
+
+#include <stdarg.h>
+
+#define VARIA_NO_MAIN
+#define VARIA_COUNT_STATEMENTS // For statements/s.
+#include "main.c"
+
+#define BENCH_RUNS 3 // We keep the fastest.
+
+struct Source {
+    char *data;
+    u64 length, capacity;
+};
+
+void
+source_append(struct Source *source, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(source->data + source->length, source->capacity - source->length, format, args);
+        va_end(args);
+        
+        if (source->length + length < source->capacity) {
+            source->length += length;
+            return;
+        }
+        
+        source->capacity = source->capacity ? source->capacity*2 : Megabytes(1);
+        source->data = realloc(source->data, source->capacity);
+        Assert(source->data);
+    }
+}
+
+// Lots of small functions, called once each.
+// Mostly measures the tokenizer and the compiler.
+u64
+generate_functions(struct Source *source, int count) {
+    for (int i = 0; i < count; i++) {
+        source_append(source,
+                      "f%d :: (a: int, b: int) -> int {\n"
+                      "    x := a * 3 + b;\n"
+                      "    y := x - a / 2;\n"
+                      "    return x + y;\n"
+                      "}\n\n", i);
+    }
+    
+    source_append(source, "main :: () {\n    sum := 0;\n");
+    for (int i = 0; i < count; i++) {
+        source_append(source, "    sum = sum + f%d(%d, 1);\n", i, i);
+    }
+    source_append(source, "    print(sum);\n}\n");
+    
+    return count;
+}
+
+// Blocks that each declare lots of variables.
+u64
+generate_variables(struct Source *source, int blocks, int variables_per_block) {
+    source_append(source, "main :: () {\n    total := 0;\n");
+    for (int block = 0; block < blocks; block++) {
+        source_append(source, "    {\n        v0 := %d;\n", block);
+        for (int i = 1; i < variables_per_block; i++) {
+            source_append(source, "        v%d := v%d + %d;\n", i, i-1, i);
+        }
+        source_append(source, "        total = total + v%d;\n    }\n", variables_per_block-1);
+    }
+    source_append(source, "    print(total);\n}\n");
+    
+    return 0;
+}
+
+// One long chain of arithmetic on a couple of variables.
+u64
+generate_expressions(struct Source *source, int count) {
+    source_append(source, "main :: () {\n    x := 1;\n    f := 1.0;\n");
+    for (int i = 0; i < count; i++) {
+        if (i & 1) {
+            source_append(source, "    f = f * 0.5 + (1.0 - f) / 3.0;\n");
+        } else {
+            source_append(source, "    x = (x * 3 + %d) / 4 - x / 5;\n", i % 100);
+        }
+    }
+    source_append(source, "    print(x);\n    print(f);\n}\n");
+    
+    return 0;
+}
+
+// A binary tree of calls, depth levels deep.
+u64
+generate_calls(struct Source *source, int depth) {
+    source_append(source, "main :: () {\n    print(f0(1));\n}\n\n");
+    for (int i = 0; i < depth; i++) {
+        source_append(source,
+                      "f%d :: (n: int) -> int {\n"
+                      "    return f%d(n) + f%d(n + 1);\n"
+                      "}\n\n", i, i+1, i+1);
+    }
+    source_append(source, "f%d :: (n: int) -> int {\n    return n;\n}\n", depth);
+    
+    // Every level calls the next one twice.
+    return ((u64)1 << (depth+1)) - 1;
+}
+
+// Recursion almost as deep as calls can go, a few times over. Unlike the
+// tree above, the stack grows the whole way down, and the locals make the
+// frames big enough for it to take a few steps of committing the heap.
+u64
+generate_recursion(struct Source *source, int depth, int repeats) {
+    source_append(source,
+                  "down :: (n: int) -> int {\n"
+                  "    if n == 0 {\n"
+                  "        return 0;\n"
+                  "    }\n"
+                  "    a := n * 2;\n"
+                  "    b := a + n;\n"
+                  "    c := b - a;\n"
+                  "    d := c * 3;\n"
+                  "    return down(n - 1) + d - n * 3 + 1;\n"
+                  "}\n"
+                  "\n"
+                  "main :: () {\n"
+                  "    i := 0;\n"
+                  "    total := 0;\n"
+                  "    while i < %d {\n"
+                  "        total = total + down(%d);\n"
+                  "        i = i + 1;\n"
+                  "    }\n"
+                  "    print(total);\n"
+                  "}\n", repeats, depth);
+    
+    return (u64)repeats * (u64)(depth+1);
+}
+
+// A loop with a branch in it, which is what the
+// unrolled programs above would be written as.
+u64
+generate_loops(struct Source *source, int iterations) {
+    source_append(source,
+                  "main :: () {\n"
+                  "    i := 0;\n"
+                  "    sum := 0;\n"
+                  "    while i < %d {\n"
+                  "        if i - i / 3 * 3 == 0 {\n"
+                  "            sum = sum + i;\n"
+                  "        } else {\n"
+                  "            sum = sum - 1;\n"
+                  "        }\n"
+                  "        i = i + 1;\n"
+                  "    }\n"
+                  "    print(sum);\n"
+                  "}\n", iterations);
+    
+    return 0;
+}
+
+// Prints ints, floats and strings.
+u64
+generate_print(struct Source *source, int count) {
+    source_append(source, "main :: () {\n    i := 123456789;\n    f := 3.14159;\n");
+    for (int n = 0; n < count; n++) {
+        switch (n % 3) {
+            case 0: source_append(source, "    print(i + %d);\n", n); break;
+            case 1: source_append(source, "    print(f * %d.5);\n", n); break;
+            case 2: source_append(source, "    print(\"line of text\\n\");\n"); break;
+        }
+    }
+    source_append(source, "}\n");
+    
+    return count;
+}
+
+struct Bench_Result {
+    const char *name;
+    u64 source_bytes;
+    int token_count;
+    u64 calls; // Function calls made while running, 0 if we don't care.
+    
+    u64 tokenize_ns;
+    struct Stats stats;
+};
+
+struct Bench_Result
+bench_run(const char *name, struct Source *source, u64 calls) {
+    struct Bench_Result best = {0};
+    
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        struct Bench_Result result = {0};
+        result.name = name;
+        result.source_bytes = source->length;
+        result.calls = calls;
+        
+        u64 start = platform_nanoseconds();
+        struct Tokenizer tokenizer = tokenize(name, source->data, source->length);
+        result.tokenize_ns = platform_nanoseconds() - start;
+        result.token_count = tokenizer.token_count;
+        
+        interpret(tokenizer, (struct Options){0}, &result.stats);
+        tokenizer_free(&tokenizer);
+        
+        u64 total = result.tokenize_ns + result.stats.compile_ns + result.stats.run_ns;
+        u64 best_total = best.tokenize_ns + best.stats.compile_ns + best.stats.run_ns;
+        if (run == 0 || total < best_total) {
+            best = result;
+        }
+    }
+    
+    source->length = 0;
+    return best;
+}
+
+f64
+per_second(u64 count, u64 ns) {
+    return ns ? (f64)count * 1e9 / (f64)ns : 0;
+}
+
+void
+bench_write_json(FILE *file, struct Bench_Result *results, int count) {
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    
+    for (int i = 0; i < count; i++) {
+        struct Bench_Result *r = &results[i];
+        fprintf(file,
+                "    {\n"
+                "      \"name\": \"%s\",\n"
+                "      \"source_bytes\": %llu,\n"
+                "      \"tokens\": %d,\n"
+                "      \"statements\": %d,\n"
+                "      \"statements_run\": %llu,\n"
+                "      \"calls\": %llu,\n"
+                "      \"tokenize_ns\": %llu,\n"
+                "      \"compile_ns\": %llu,\n"
+                "      \"run_ns\": %llu,\n"
+                "      \"tokens_per_second\": %.0f,\n"
+                "      \"statements_per_second\": %.0f,\n"
+                "      \"compiled_statements_per_second\": %.0f,\n"
+                "      \"ns_per_call\": %.2f,\n"
+                "      \"peak_memory_bytes\": %llu\n"
+                "    }%s\n",
+                r->name,
+                (unsigned long long)r->source_bytes,
+                r->token_count,
+                r->stats.statement_count,
+                (unsigned long long)r->stats.statements_run,
+                (unsigned long long)r->calls,
+                (unsigned long long)r->tokenize_ns,
+                (unsigned long long)r->stats.compile_ns,
+                (unsigned long long)r->stats.run_ns,
+                per_second(r->token_count, r->tokenize_ns),
+                per_second(r->stats.statements_run, r->stats.run_ns),
+                per_second(r->stats.statement_count, r->stats.compile_ns),
+                r->calls ? (f64)r->stats.run_ns / (f64)r->calls : 0,
+                (unsigned long long)r->stats.memory_used,
+                i+1 < count ? "," : "");
+    }
+    
+    fprintf(file, "  ]\n}\n");
+}
+
+int
+main(int argc, char **argv) {
+    const char *output_path = argc > 1 ? argv[1] : "bench.json";
+    
+    struct Source source = {0};
+    struct Bench_Result results[16];
+    int result_count = 0;
+    
+    u64 calls;
+    
+    calls = generate_functions(&source, 1000);
+    results[result_count++] = bench_run("functions", &source, calls);
+    
+    calls = generate_variables(&source, 200, 1000);
+    results[result_count++] = bench_run("variables", &source, calls);
+    
+    calls = generate_expressions(&source, 200000);
+    results[result_count++] = bench_run("expressions", &source, calls);
+    
+    calls = generate_calls(&source, 20);
+    results[result_count++] = bench_run("calls", &source, calls);
+    
+    // main() and the first call take two of the levels.
+    calls = generate_recursion(&source, MAX_CALL_DEPTH - 2, 20);
+    results[result_count++] = bench_run("recursion", &source, calls);
+    
+    calls = generate_loops(&source, 10000000);
+    results[result_count++] = bench_run("loops", &source, calls);
+    
+    calls = generate_print(&source, 300000);
+    results[result_count++] = bench_run("print", &source, calls);
+    
+    FILE *file = fopen(output_path, "w");
+    if (!file) {
+        Error("Couldn't open %s!\n", output_path);
+        return 1;
+    }
+    bench_write_json(file, results, result_count);
+    fclose(file);
+    
+    // A summary for people, on stderr since stdout has the programs' output.
+    Error("%-12s %14s %14s %12s %14s\n", "", "tokens/s", "statements/s", "ns/call", "peak memory");
+    for (int i = 0; i < result_count; i++) {
+        struct Bench_Result *r = &results[i];
+        Error("%-12s %14.0f %14.0f %12.2f %13lluB\n",
+              r->name,
+              per_second(r->token_count, r->tokenize_ns),
+              per_second(r->stats.statements_run, r->stats.run_ns),
+              r->calls ? (f64)r->stats.run_ns / (f64)r->calls : 0,
+              (unsigned long long)r->stats.memory_used);
+    }
+    Error("Wrote %s\n", output_path);
+    
+    free(source.data);
+    return 0;
+}
@@ -0,0 +1,184 @@
+// Short strings are copied into the value itself, so
+// using them never has to follow a pointer.
+union Value
+string_value(struct String *string) {
+    union Value value = {0};
+    
+    if (string->length <= SMALL_STRING_CAPACITY) {
+        value.small_string.length_and_flag = (u8)(string->length << 1 | 1);
+        memcpy(value.small_string.data, string->data, string->length);
+    } else {
+        Assert(((uintptr_t)string & 7) == 0);
+        value.string = string;
+    }
+    
+    return value;
+}
+
+// Returns the string's bytes, which aren't null terminated if it's small.
+const char *
+string_data(union Value *value, u64 *length) {
+    if (value->small_string.length_and_flag & 1) {
+        *length = value->small_string.length_and_flag >> 1;
+        return value->small_string.data;
+    }
+    
+    *length = value->string->length;
+    return value->string->data;
+}
+
+// How many values the instruction pushes, minus how many it pops.
+// OP_CALL depends on the callee, so emit_call() takes care of it.
+int
+stack_effect(enum Opcode op) {
+    switch (op) {
+        case OP_PUSH: case OP_LOAD: {
+            return 1;
+        }
+        case OP_STORE: case OP_POP:
+        case OP_ADD_S64: case OP_SUBTRACT_S64: case OP_MULTIPLY_S64: case OP_DIVIDE_S64:
+        case OP_ADD_F64: case OP_SUBTRACT_F64: case OP_MULTIPLY_F64: case OP_DIVIDE_F64:
+        case OP_EQUAL_S64: case OP_NOT_EQUAL_S64: case OP_LESS_S64:
+        case OP_LESS_EQUAL_S64: case OP_GREATER_S64: case OP_GREATER_EQUAL_S64:
+        case OP_EQUAL_F64: case OP_NOT_EQUAL_F64: case OP_LESS_F64:
+        case OP_LESS_EQUAL_F64: case OP_GREATER_F64: case OP_GREATER_EQUAL_F64:
+        case OP_JUMP_IF_ZERO:
+        case OP_PRINT_U8: case OP_PRINT_S64: case OP_PRINT_F64: case OP_PRINT_STRING:
+        case OP_RETURN_VALUE: {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void
+bytecode_adjust_depth(struct Bytecode *bytecode, int change) {
+    bytecode->depth += change;
+    Assert(bytecode->depth >= 0);
+    if (bytecode->depth > bytecode->max_depth) {
+        bytecode->max_depth = bytecode->depth;
+    }
+}
+
+struct Instruction *
+emit(struct Bytecode *bytecode, enum Opcode op, int operand) {
+    if (bytecode->count == bytecode->capacity) {
+        bytecode->capacity = bytecode->capacity ? bytecode->capacity*2 : 64;
+        bytecode->code = realloc(bytecode->code,
+                                 bytecode->capacity * sizeof(struct Instruction));
+        Assert(bytecode->code);
+    }
+
+    struct Instruction *instruction = &bytecode->code[bytecode->count++];
+    instruction->op = op;
+    instruction->operand = operand;
+    instruction->imm.s64 = 0;
+    
+    bytecode_adjust_depth(bytecode, stack_effect(op));
+    return instruction;
+}
+
+void
+emit_call(struct Bytecode *bytecode, int function_index, int parameter_count, bool returns_value) {
+    emit(bytecode, OP_CALL, function_index);
+    bytecode_adjust_depth(bytecode, (returns_value ? 1 : 0) - parameter_count);
+}
+
+// Emits a jump to wherever patch_jump() is called, and returns
+// its index. (Not a pointer, since emitting more might move it.)
+int
+emit_jump(struct Bytecode *bytecode, enum Opcode op) {
+    emit(bytecode, op, 0);
+    return bytecode->count - 1;
+}
+
+// Points the jump at the next instruction to be emitted.
+void
+patch_jump(struct Bytecode *bytecode, int jump) {
+    bytecode->code[jump].operand = bytecode->count - (jump + 1);
+}
+
+// Emits a jump back to the instruction at `target`.
+void
+emit_loop(struct Bytecode *bytecode, int target) {
+    emit(bytecode, OP_JUMP, target - (bytecode->count + 1));
+}
+
+void
+emit_push(struct Bytecode *bytecode, union Value value) {
+    struct Instruction *instruction = emit(bytecode, OP_PUSH, 0);
+    instruction->imm = value;
+}
+
+const char *
+opcode_name(enum Opcode op) {
+    switch (op) {
+        case OP_NONE:         return "none";
+        case OP_PUSH:         return "push";
+        case OP_LOAD:         return "load";
+        case OP_STORE:        return "store";
+        case OP_POP:          return "pop";
+        case OP_ADD_S64:      return "add_s64";
+        case OP_SUBTRACT_S64: return "sub_s64";
+        case OP_MULTIPLY_S64: return "mul_s64";
+        case OP_DIVIDE_S64:   return "div_s64";
+        case OP_ADD_F64:      return "add_f64";
+        case OP_SUBTRACT_F64: return "sub_f64";
+        case OP_MULTIPLY_F64: return "mul_f64";
+        case OP_DIVIDE_F64:   return "div_f64";
+        case OP_NEGATE_S64:   return "neg_s64";
+        case OP_NEGATE_F64:   return "neg_f64";
+        case OP_EQUAL_S64:         return "eq_s64";
+        case OP_NOT_EQUAL_S64:     return "ne_s64";
+        case OP_LESS_S64:          return "lt_s64";
+        case OP_LESS_EQUAL_S64:    return "le_s64";
+        case OP_GREATER_S64:       return "gt_s64";
+        case OP_GREATER_EQUAL_S64: return "ge_s64";
+        case OP_EQUAL_F64:         return "eq_f64";
+        case OP_NOT_EQUAL_F64:     return "ne_f64";
+        case OP_LESS_F64:          return "lt_f64";
+        case OP_LESS_EQUAL_F64:    return "le_f64";
+        case OP_GREATER_F64:       return "gt_f64";
+        case OP_GREATER_EQUAL_F64: return "ge_f64";
+        case OP_JUMP:              return "jump";
+        case OP_JUMP_IF_ZERO:      return "jump_if_zero";
+        case OP_CALL:         return "call";
+        case OP_PRINT_U8:     return "print_u8";
+        case OP_PRINT_S64:    return "print_s64";
+        case OP_PRINT_F64:    return "print_f64";
+        case OP_PRINT_STRING: return "print_string";
+        case OP_RETURN:       return "return";
+        case OP_RETURN_VALUE: return "return_value";
+        case OP_STATEMENT:    return "statement";
+    }
+    return "?";
+}
+
+void
+print_bytecode(struct Bytecode *bytecode) {
+    Log("Instruction Count: %d\n", bytecode->count);
+
+    for (int i = 0; i < bytecode->count; i++) {
+        struct Instruction *instruction = &bytecode->code[i];
+
+        switch (instruction->op) {
+            case OP_PUSH: {
+                Log("%4d: %s 0x%llx\n", i, opcode_name(instruction->op),
+                    (unsigned long long)instruction->imm.s64);
+                break;
+            }
+            case OP_LOAD: case OP_STORE: case OP_CALL: {
+                Log("%4d: %s %d\n", i, opcode_name(instruction->op), instruction->operand);
+                break;
+            }
+            case OP_JUMP: case OP_JUMP_IF_ZERO: {
+                Log("%4d: %s -> %d\n", i, opcode_name(instruction->op), i + 1 + instruction->operand);
+                break;
+            }
+            default: {
+                Log("%4d: %s\n", i, opcode_name(instruction->op));
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,104 @@
+// Function bodies are compiled once into a flat array of instructions
+// for a small stack machine, so we never walk the tokens at runtime.
+
+enum Opcode {
+    OP_NONE,
+
+    OP_PUSH,  // Push instruction->imm.
+    OP_LOAD,  // Push slots[operand].
+    OP_STORE, // Pop into slots[operand].
+    OP_POP,   // Drop the top of the stack.
+
+    OP_ADD_S64,
+    OP_SUBTRACT_S64,
+    OP_MULTIPLY_S64,
+    OP_DIVIDE_S64,
+
+    OP_ADD_F64,
+    OP_SUBTRACT_F64,
+    OP_MULTIPLY_F64,
+    OP_DIVIDE_F64,
+    
+    OP_NEGATE_S64,
+    OP_NEGATE_F64,
+    
+    // Comparisons push 1 if they're true, 0 otherwise.
+    OP_EQUAL_S64,
+    OP_NOT_EQUAL_S64,
+    OP_LESS_S64,
+    OP_LESS_EQUAL_S64,
+    OP_GREATER_S64,
+    OP_GREATER_EQUAL_S64,
+    
+    OP_EQUAL_F64,
+    OP_NOT_EQUAL_F64,
+    OP_LESS_F64,
+    OP_LESS_EQUAL_F64,
+    OP_GREATER_F64,
+    OP_GREATER_EQUAL_F64,
+    
+    // operand is how many instructions to skip, counting
+    // from the next one, so it's negative for loops.
+    OP_JUMP,
+    OP_JUMP_IF_ZERO, // Pops the condition.
+
+    // Call program.functions[operand]. The arguments on top of the
+    // stack become the first slots of the callee's frame, and are
+    // replaced by the return value, if it has one.
+    OP_CALL,
+
+    OP_PRINT_U8,
+    OP_PRINT_S64,
+    OP_PRINT_F64,
+    OP_PRINT_STRING,
+
+    OP_RETURN,
+    OP_RETURN_VALUE, // Return the top of the stack.
+    
+    // Adds one to program.statements_run. Only emitted at the start of
+    // each statement when we're built with VARIA_COUNT_STATEMENTS.
+    OP_STATEMENT,
+
+    OP_COUNT
+};
+
+#define SMALL_STRING_CAPACITY 7
+
+// Strings of up to SMALL_STRING_CAPACITY bytes are stored right in the
+// value, with the length in small_string.length_and_flag as length<<1|1.
+// Anything else is a pointer to a String, which is 8 byte aligned, so
+// that byte's lowest bit is 0. (That's the low byte of the pointer,
+// since we only run on little endian machines.)
+union Value {
+    u8 u8;
+    s64 s64;
+    f64 f64;
+    struct String *string; // Usually in tokenizer.strings.
+    
+    struct {
+        u8 length_and_flag;
+        char data[SMALL_STRING_CAPACITY];
+    } small_string;
+};
+
+// Stack frames live on program.stack, and look like this:
+//
+//   slots[0 .. slot_count)         Parameters, then locals.
+//   [slot_count .. +max_depth)     Temporaries the instructions push.
+//
+// A call's arguments are pushed as temporaries of the caller,
+// and the callee's frame starts at the first argument.
+
+struct Instruction {
+    enum Opcode op;
+    int operand;     // Slot, function index or jump offset.
+    union Value imm; // Only used by OP_PUSH.
+};
+
+struct Bytecode {
+    struct Instruction *code;
+    int count, capacity;
+    
+    int depth;     // Stack depth after the last instruction emitted.
+    int max_depth; // Deepest the stack gets while running this code.
+};
@@ -0,0 +1,372 @@
+// Tokenizing a big program takes a while, so what the tokenizer makes
+// is saved next to the source, in <source>.vcache, and the next run
+// with the same source loads that instead of tokenizing again.
+//
+// The cache file is mapped copy on write, and the tokens, function
+// definitions, symbol table and constants are used right where they
+// are. Since the file's mapped somewhere else every time, it holds
+// offsets instead of pointers. Tokens only have offsets and indices
+// anyway, so it's just the symbol names and the string constants that
+// get their pointers filled in after loading.
+
+#define CACHE_MAGIC 0x48434156 // "VACH"
+
+// Bump this whenever the tokenizer makes something different from the
+// same source, or the layout of anything in the file changes.
+#define CACHE_VERSION 1
+
+struct Cache_Header {
+    u32 magic;
+    u32 version;
+    
+    // In case one of them changes without the version being bumped.
+    u32 token_size, symbol_size, constant_size;
+    
+    // What the source has to be for the cache to be used.
+    u64 source_hash, source_length;
+    
+    int line_count;
+    int token_count; // Not counting the TOKEN_NONE at the end, which is in the file too.
+    int function_def_count;
+    int symbol_count;
+    u32 symbol_id_capacity;
+    int constant_count;
+    
+    // Where each array starts in the file. They're all 8 byte aligned.
+    u64 tokens, function_defs, symbols, symbol_ids, constants, strings;
+    u64 strings_size;
+};
+
+// 64 bits at a time, so checking whether the source has
+// changed costs a lot less than tokenizing it again.
+u64
+hash_source(const char *data, u64 length) {
+    u64 hash = 0x9E3779B97F4A7C15ull ^ length;
+    u64 i = 0;
+    
+    for (; i+8 <= length; i += 8) {
+        u64 word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    
+    if (i < length) {
+        u64 word = 0;
+        memcpy(&word, data + i, length - i);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+    }
+    
+    hash = (hash ^ (hash >> 29)) * 0xC4CEB9FE1A85EC53ull;
+    return hash ^ (hash >> 32);
+}
+
+u64
+cache_align(u64 offset) {
+    return (offset + 7) & ~(u64)7;
+}
+
+// Writes size bytes, then pads up to the next multiple of 8.
+void
+cache_write(FILE *file, const void *data, u64 size, bool *ok) {
+    static const u8 zeros[8] = {0};
+    
+    if (size && fwrite(data, 1, size, file) != size) {
+        *ok = false;
+    }
+    u64 padding = cache_align(size) - size;
+    if (padding && fwrite(zeros, 1, padding, file) != padding) {
+        *ok = false;
+    }
+}
+
+// Saves what the tokenizer made from the source with hash source_hash.
+// It's only a cache, so if it can't be written, nothing happens.
+void
+cache_save(struct Tokenizer *tokenizer, const char *path, u64 source_hash) {
+    struct Cache_Header header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .token_size = sizeof(struct Token),
+        .symbol_size = sizeof(struct Symbol),
+        .constant_size = sizeof(struct Constant),
+        .source_hash = source_hash,
+        .source_length = tokenizer->buffer_length,
+        .line_count = tokenizer->current_line,
+        .token_count = tokenizer->token_count,
+        .function_def_count = tokenizer->function_def_count,
+        .symbol_count = tokenizer->symbols.symbol_count,
+        .symbol_id_capacity = tokenizer->symbols.id_capacity,
+        .constant_count = tokenizer->constant_count,
+    };
+    
+    for (int i = 0; i < tokenizer->constant_count; i++) {
+        struct Constant *constant = &tokenizer->constants[i];
+        if (constant->type == CONSTANT_STRING) {
+            header.strings_size += cache_align(sizeof(struct String) + constant->string->length + 1);
+        }
+    }
+    
+    header.tokens        = cache_align(sizeof(struct Cache_Header));
+    header.function_defs = header.tokens + cache_align((u64)(header.token_count+1) * sizeof(struct Token));
+    header.symbols       = header.function_defs + cache_align((u64)header.function_def_count * sizeof(u32));
+    header.symbol_ids    = header.symbols + cache_align((u64)header.symbol_count * sizeof(struct Symbol));
+    header.constants     = header.symbol_ids + cache_align((u64)header.symbol_id_capacity * sizeof(u32));
+    header.strings       = header.constants + cache_align((u64)header.constant_count * sizeof(struct Constant));
+    
+    // Written somewhere else first, and then renamed over the old one,
+    // so a run that's reading the cache sees all of the old one or all of
+    // the new one. Every process writes to its own file, so runs that save
+    // at the same time don't write into each other's.
+    char temp_path[512];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.%u.tmp", path, platform_process_id()) >= (int)sizeof(temp_path)) {
+        return;
+    }
+    
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) return;
+    
+    bool ok = true;
+    cache_write(file, &header, sizeof(header), &ok);
+    cache_write(file, tokenizer->tokens, (u64)(header.token_count+1) * sizeof(struct Token), &ok);
+    cache_write(file, tokenizer->function_defs, (u64)header.function_def_count * sizeof(u32), &ok);
+    
+    // Names become offsets into the source. The built in ones aren't in
+    // there, but they're always the same, so they're just left out.
+    for (int i = 0; i < header.symbol_count; i++) {
+        struct Symbol symbol = tokenizer->symbols.symbols[i];
+        symbol.name = i < SYMBOL_BUILTIN_COUNT ? NULL : (const char*)(uintptr_t)(symbol.name - tokenizer->buffer);
+        cache_write(file, &symbol, sizeof(symbol), &ok);
+    }
+    cache_write(file, tokenizer->symbols.ids, (u64)header.symbol_id_capacity * sizeof(u32), &ok);
+    
+    // Strings become offsets from the start of the strings.
+    u64 string_offset = 0;
+    for (int i = 0; i < header.constant_count; i++) {
+        // Copied field by field onto zeros, so the padding after type
+        // doesn't write whatever was in memory, and the same source always
+        // makes the same file.
+        struct Constant constant;
+        memset(&constant, 0, sizeof(constant));
+        constant.type = tokenizer->constants[i].type;
+        constant.int_value = tokenizer->constants[i].int_value;
+        if (constant.type == CONSTANT_STRING) {
+            u64 size = sizeof(struct String) + constant.string->length + 1;
+            constant.string = (struct String*)(uintptr_t)string_offset;
+            string_offset += cache_align(size);
+        }
+        cache_write(file, &constant, sizeof(constant), &ok);
+    }
+    for (int i = 0; i < header.constant_count; i++) {
+        struct Constant *constant = &tokenizer->constants[i];
+        if (constant->type == CONSTANT_STRING) {
+            cache_write(file, constant->string, sizeof(struct String) + constant->string->length + 1, &ok);
+        }
+    }
+    
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    
+    if (!ok || !platform_replace_file(temp_path, path)) {
+        remove(temp_path);
+    }
+}
+
+// Whether the array of count elements at offset fits in the file.
+bool
+cache_fits(struct Mapped_File *file, u64 offset, u64 count, u64 size) {
+    return offset <= file->size && count <= (file->size - offset) / size;
+}
+
+// Checks everything that indexes into something else, or into the
+// source, so a cache file that's been cut short or scribbled on can't
+// send anything out of bounds, or send a lookup round forever. The hash
+// only says the source is the same, not that the rest of the file is
+// what we wrote.
+//
+// That's a walk over the whole file, but so is filling in the pointers,
+// and it's a small part of what tokenizing again would cost. A checksum
+// would be a walk too, and wouldn't catch a file that was written wrong.
+bool
+cache_check(struct Mapped_File *file, struct Cache_Header *header, u64 source_length) {
+    u8 *base = (u8*)file->data;
+    
+    struct Token *tokens = (struct Token*)(base + header->tokens);
+    for (int i = 0; i < header->token_count; i++) {
+        struct Token *token = &tokens[i];
+        if ((u64)token->offset + token->length > source_length) return false;
+        
+        switch (token->type) {
+            case TOKEN_NONE: {
+                return false;
+            }
+            case TOKEN_IDENTIFIER: {
+                if (token->symbol >= (u32)header->symbol_count) return false;
+                break;
+            }
+            case TOKEN_LITERAL: {
+                if (token->constant >= (u32)header->constant_count) return false;
+                break;
+            }
+            case TOKEN_OPEN_SCOPE: case TOKEN_CLOSE_SCOPE: {
+                // The other brace of the pair, on the right side of this one, pointing back.
+                bool open = token->type == TOKEN_OPEN_SCOPE;
+                if (token->match >= (u32)header->token_count || (token->match > (u32)i) != open) return false;
+                
+                struct Token *other = &tokens[token->match];
+                if (other->type != (open ? TOKEN_CLOSE_SCOPE : TOKEN_OPEN_SCOPE) || other->match != (u32)i) return false;
+                break;
+            }
+        }
+    }
+    if (tokens[header->token_count].type != TOKEN_NONE) return false;
+    
+    u32 *function_defs = (u32*)(base + header->function_defs);
+    for (int i = 0; i < header->function_def_count; i++) {
+        if (function_defs[i] >= (u32)header->token_count) return false;
+        if (tokens[function_defs[i]].type != TOKEN_IDENTIFIER) return false;
+    }
+    
+    struct Symbol *symbols = (struct Symbol*)(base + header->symbols);
+    for (int i = SYMBOL_BUILTIN_COUNT; i < header->symbol_count; i++) {
+        u64 offset = (u64)(uintptr_t)symbols[i].name;
+        if (symbols[i].length < 0 || offset > source_length ||
+            (u64)symbols[i].length > source_length - offset)
+        {
+            return false;
+        }
+    }
+    
+    u32 capacity = header->symbol_id_capacity;
+    if (capacity == 0 || (capacity & (capacity-1)) || (u32)header->symbol_count >= capacity) return false;
+    u32 *ids = (u32*)(base + header->symbol_ids);
+    u32 empty = 0;
+    for (u32 i = 0; i < capacity; i++) {
+        if (ids[i] >= (u32)header->symbol_count) return false;
+        if (!ids[i]) empty++;
+    }
+    if (!empty) return false; // Looking up a symbol that isn't there would never stop.
+    
+    struct Constant *constants = (struct Constant*)(base + header->constants);
+    for (int i = 0; i < header->constant_count; i++) {
+        struct Constant *constant = &constants[i];
+        if (constant->type > CONSTANT_STRING) return false;
+        if (constant->type != CONSTANT_STRING) continue;
+        
+        u64 offset = (u64)(uintptr_t)constant->string;
+        if (offset & 7 || offset > header->strings_size ||
+            header->strings_size - offset < sizeof(struct String))
+        {
+            return false;
+        }
+        struct String *string = (struct String*)(base + header->strings + offset);
+        if (string->length >= header->strings_size - offset - sizeof(struct String) ||
+            string->data[string->length] != 0)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+// Loads the cache at path into the tokenizer, if it was made
+// from exactly this source, by this version of the tokenizer.
+bool
+cache_load(struct Tokenizer *tokenizer, const char *path, const char *file_name,
+           char *source, u64 source_length, u64 source_hash)
+{
+    struct Mapped_File file;
+    if (!platform_map_file(path, &file, true)) {
+        return false;
+    }
+    
+    struct Cache_Header *header = (struct Cache_Header*)file.data;
+    
+    bool valid = file.size >= sizeof(struct Cache_Header) &&
+                 header->magic == CACHE_MAGIC &&
+                 header->version == CACHE_VERSION &&
+                 header->token_size == sizeof(struct Token) &&
+                 header->symbol_size == sizeof(struct Symbol) &&
+                 header->constant_size == sizeof(struct Constant) &&
+                 header->source_hash == source_hash &&
+                 header->source_length == source_length;
+    
+    valid = valid &&
+            header->token_count >= 0 && header->function_def_count >= 0 &&
+            header->symbol_count >= SYMBOL_BUILTIN_COUNT && header->constant_count >= 0 &&
+            cache_fits(&file, header->tokens, (u64)header->token_count+1, sizeof(struct Token)) &&
+            cache_fits(&file, header->function_defs, (u64)header->function_def_count, sizeof(u32)) &&
+            cache_fits(&file, header->symbols, (u64)header->symbol_count, sizeof(struct Symbol)) &&
+            cache_fits(&file, header->symbol_ids, header->symbol_id_capacity, sizeof(u32)) &&
+            cache_fits(&file, header->constants, (u64)header->constant_count, sizeof(struct Constant)) &&
+            cache_fits(&file, header->strings, header->strings_size, 1) &&
+            cache_check(&file, header, source_length);
+    
+    if (!valid) {
+        platform_unmap_file(&file);
+        return false;
+    }
+    
+    u8 *base = (u8*)file.data;
+    
+    *tokenizer = (struct Tokenizer){0};
+    snprintf(tokenizer->file_name, sizeof(tokenizer->file_name), "%s", file_name);
+    tokenizer->buffer = source;
+    tokenizer->buffer_length = source_length;
+    tokenizer->current_line = header->line_count;
+    
+    tokenizer->tokens = (struct Token*)(base + header->tokens);
+    tokenizer->token_count = header->token_count;
+    tokenizer->token_capacity = header->token_count+1;
+    
+    tokenizer->function_defs = (u32*)(base + header->function_defs);
+    tokenizer->function_def_count = tokenizer->function_def_capacity = header->function_def_count;
+    
+    struct Symbol_Table *symbols = &tokenizer->symbols;
+    symbols->symbols = (struct Symbol*)(base + header->symbols);
+    symbols->symbol_count = symbols->symbol_capacity = header->symbol_count;
+    symbols->ids = (u32*)(base + header->symbol_ids);
+    symbols->id_capacity = header->symbol_id_capacity;
+    
+    for (int i = 0; i < symbols->symbol_count; i++) {
+        struct Symbol *symbol = &symbols->symbols[i];
+        symbol->name = i < SYMBOL_BUILTIN_COUNT ? builtin_symbol_names[i] : source + (uintptr_t)symbol->name;
+    }
+    
+    tokenizer->constants = (struct Constant*)(base + header->constants);
+    tokenizer->constant_count = tokenizer->constant_capacity = header->constant_count;
+    
+    for (int i = 0; i < tokenizer->constant_count; i++) {
+        struct Constant *constant = &tokenizer->constants[i];
+        if (constant->type == CONSTANT_STRING) {
+            constant->string = (struct String*)(base + header->strings + (uintptr_t)constant->string);
+        }
+    }
+    
+    tokenizer->cache = file;
+    return true;
+}
+
+// tokenize(), but it loads the tokens from the source's cache
+// file if it can, and saves them there if it can't.
+struct Tokenizer
+tokenize_cached(const char *file_name, char *source, u64 source_length) {
+    // A path too long for the buffer would be cut short, and name some other file.
+    char path[512];
+    if (snprintf(path, sizeof(path), "%s.vcache", file_name) >= (int)sizeof(path)) {
+        return tokenize(file_name, source, source_length);
+    }
+    
+    u64 source_hash = hash_source(source, source_length);
+    
+    struct Tokenizer tokenizer;
+    if (cache_load(&tokenizer, path, file_name, source, source_length, source_hash)) {
+        return tokenizer;
+    }
+    
+    tokenizer = tokenize(file_name, source, source_length);
+    cache_save(&tokenizer, path, source_hash);
+    return tokenizer;
+}
@@ -0,0 +1,575 @@
+// --emit-c writes the type checked program out as C, instead of running
+// it, so programs that don't change can be built once with a real C
+// compiler. It works from the same statement and expression trees
+// the bytecode compiler does.
+//
+// The C does the same thing the VM would: ints wrap around, division
+// by zero stops the program with the same message, and calls in an
+// expression happen left to right. (C doesn't promise that, so those
+// calls are pulled out into temporaries first.) The only difference is
+// that the C stack limits recursion, not MAX_CALL_DEPTH.
+
+struct C_Hoisted_Call {
+    struct Expr *call;
+    int id; // It's in t_<id>.
+};
+
+struct C_Emitter {
+    struct Interpreter *interp;
+    FILE *file;
+    struct Function *function;
+    int indent;
+    
+    // A slot can be used for different variables, even with different
+    // types, so every variable gets its own C name: <name>_<id>.
+    // These say which one each slot holds at this point in the function.
+    u32 *slot_symbols;
+    int *slot_ids;
+    int next_id;
+    
+    // Calls in the statement being written that were pulled out into temporaries.
+    struct C_Hoisted_Call *hoisted;
+    int hoisted_count, hoisted_capacity;
+};
+
+static const char c_runtime[] =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <math.h>\n"
+    "\n"
+    "typedef struct { uint64_t length; const char *data; } varia_string;\n"
+    "\n"
+    "static inline void varia_print_u8(uint8_t value) { putchar(value); }\n"
+    "static inline void varia_print_s64(int64_t value) { printf(\"%lld\\n\", (long long)value); }\n"
+    "static inline void varia_print_f64(double value) { printf(\"%f\\n\", value); }\n"
+    "static inline void varia_print_string(varia_string value) { fwrite(value.data, 1, value.length, stdout); }\n"
+    "\n"
+    "// Ints wrap around instead of overflowing.\n"
+    "static inline int64_t varia_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }\n"
+    "static inline int64_t varia_subtract(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }\n"
+    "static inline int64_t varia_multiply(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }\n"
+    "static inline int64_t varia_negate(int64_t a) { return (int64_t)(0 - (uint64_t)a); }\n"
+    "\n"
+    "static inline int64_t varia_divide(int64_t a, int64_t b, const char *function) {\n"
+    "    if (b == 0) {\n"
+    "        fflush(stdout);\n"
+    "        fprintf(stderr, \"Division by zero in %s()!\\n\", function);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    return b == -1 ? varia_negate(a) : a / b;\n"
+    "}\n";
+
+const char *
+c_type_name(enum Type type) {
+    switch (type) {
+        case TYPE_U8:     return "uint8_t";
+        case TYPE_S64:    return "int64_t";
+        case TYPE_F64:    return "double";
+        case TYPE_STRING: return "varia_string";
+    }
+    return "void";
+}
+
+void
+c_indent(struct C_Emitter *emitter) {
+    for (int i = 0; i < emitter->indent; i++) {
+        fputs("    ", emitter->file);
+    }
+}
+
+void
+c_variable_name(struct C_Emitter *emitter, int slot) {
+    char name[MAX_TOKEN_LENGTH];
+    symbol_name(&emitter->interp->tokenizer.symbols, emitter->slot_symbols[slot], name);
+    fprintf(emitter->file, "%s_%d", name, emitter->slot_ids[slot]);
+}
+
+// Octal escapes, since a hex escape would eat any hex digits after it.
+void
+c_string_literal(FILE *file, const char *data, u64 length) {
+    fputc('"', file);
+    for (u64 i = 0; i < length; i++) {
+        u8 c = (u8)data[i];
+        if (c == '"' || c == '\\') {
+            fprintf(file, "\\%c", c);
+        } else if (c < ' ' || c >= 127) {
+            fprintf(file, "\\%03o", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void
+c_constant(struct C_Emitter *emitter, struct Expr *expr) {
+    FILE *file = emitter->file;
+    
+    switch (expr->type) {
+        case TYPE_U8: {
+            fprintf(file, "(uint8_t)%u", expr->value.u8);
+            break;
+        }
+        
+        case TYPE_S64: {
+            if (expr->value.s64 == INT64_MIN) {
+                fputs("INT64_MIN", file);
+            } else if (expr->value.s64 < 0) {
+                fprintf(file, "(%lld)", (long long)expr->value.s64);
+            } else {
+                fprintf(file, "%lld", (long long)expr->value.s64);
+            }
+            break;
+        }
+        
+        case TYPE_F64: {
+            f64 value = expr->value.f64;
+            if (isnan(value)) {
+                fputs("NAN", file);
+            } else if (isinf(value)) {
+                fputs(value < 0 ? "(-HUGE_VAL)" : "HUGE_VAL", file);
+            } else {
+                // 17 digits always reads back as the same double.
+                char text[64];
+                snprintf(text, sizeof(text), "%.17g", value);
+                bool is_double = strpbrk(text, ".e") != NULL;
+                fprintf(file, signbit(value) ? "(%s%s)" : "%s%s", text, is_double ? "" : ".0");
+            }
+            break;
+        }
+        
+        case TYPE_STRING: {
+            u64 length;
+            const char *data = string_data(&expr->value, &length);
+            fprintf(file, "(varia_string){%llu, ", (unsigned long long)length);
+            c_string_literal(file, data, length);
+            fputc('}', file);
+            break;
+        }
+    }
+}
+
+int
+c_count_calls(struct Expr *expr) {
+    switch (expr->kind) {
+        case EXPR_CALL: {
+            int count = 1;
+            for (int i = 0; i < expr->call.arg_count; i++) {
+                count += c_count_calls(expr->call.args[i]);
+            }
+            return count;
+        }
+        case EXPR_NEGATE: {
+            return c_count_calls(expr->binary.left);
+        }
+        case EXPR_BINARY: {
+            return c_count_calls(expr->binary.left) + c_count_calls(expr->binary.right);
+        }
+    }
+    return 0;
+}
+
+void c_expression(struct C_Emitter *emitter, struct Expr *expr);
+
+void
+c_call(struct C_Emitter *emitter, struct Expr *call) {
+    fprintf(emitter->file, "v_%s(", call->call.function->name);
+    for (int i = 0; i < call->call.arg_count; i++) {
+        if (i) fputs(", ", emitter->file);
+        c_expression(emitter, call->call.args[i]);
+    }
+    fputc(')', emitter->file);
+}
+
+void
+c_expression(struct C_Emitter *emitter, struct Expr *expr) {
+    FILE *file = emitter->file;
+    bool is_s64 = expr->type == TYPE_S64;
+    
+    switch (expr->kind) {
+        case EXPR_CONSTANT: {
+            c_constant(emitter, expr);
+            break;
+        }
+        
+        case EXPR_VARIABLE: {
+            c_variable_name(emitter, expr->slot);
+            break;
+        }
+        
+        case EXPR_CALL: {
+            for (int i = 0; i < emitter->hoisted_count; i++) {
+                if (emitter->hoisted[i].call == expr) {
+                    fprintf(file, "t_%d", emitter->hoisted[i].id);
+                    return;
+                }
+            }
+            c_call(emitter, expr);
+            break;
+        }
+        
+        case EXPR_NEGATE: {
+            fputs(is_s64 ? "varia_negate(" : "(-", file);
+            c_expression(emitter, expr->binary.left);
+            fputc(')', file);
+            break;
+        }
+        
+        case EXPR_BINARY: {
+            if (is_comparison(expr->op)) {
+                const char *op = "";
+                switch (expr->op) {
+                    case TOKEN_EQUAL_EQUAL:   op = "=="; break;
+                    case TOKEN_NOT_EQUAL:     op = "!="; break;
+                    case TOKEN_LESS:          op = "<"; break;
+                    case TOKEN_LESS_EQUAL:    op = "<="; break;
+                    case TOKEN_GREATER:       op = ">"; break;
+                    case TOKEN_GREATER_EQUAL: op = ">="; break;
+                }
+                fputs("(int64_t)(", file);
+                c_expression(emitter, expr->binary.left);
+                fprintf(file, " %s ", op);
+                c_expression(emitter, expr->binary.right);
+                fputc(')', file);
+            } else if (is_s64) {
+                const char *helper = "";
+                switch (expr->op) {
+                    case TOKEN_ADD:      helper = "varia_add"; break;
+                    case TOKEN_SUBTRACT: helper = "varia_subtract"; break;
+                    case TOKEN_MULTIPLY: helper = "varia_multiply"; break;
+                    case TOKEN_DIVIDE:   helper = "varia_divide"; break;
+                }
+                fprintf(file, "%s(", helper);
+                c_expression(emitter, expr->binary.left);
+                fputs(", ", file);
+                c_expression(emitter, expr->binary.right);
+                if (expr->op == TOKEN_DIVIDE) {
+                    fprintf(file, ", \"%s\"", emitter->function->name);
+                }
+                fputc(')', file);
+            } else {
+                fputc('(', file);
+                c_expression(emitter, expr->binary.left);
+                fprintf(file, " %c ", expr->op);
+                c_expression(emitter, expr->binary.right);
+                fputc(')', file);
+            }
+            break;
+        }
+    }
+}
+
+// Writes "T t_<id> = call;" for every call in the expression, in the
+// order the VM would make them, so c_expression() uses the temporaries.
+void
+c_hoist_calls_in(struct C_Emitter *emitter, struct Expr *expr) {
+    switch (expr->kind) {
+        case EXPR_CALL: {
+            for (int i = 0; i < expr->call.arg_count; i++) {
+                c_hoist_calls_in(emitter, expr->call.args[i]);
+            }
+            
+            c_indent(emitter);
+            int id = emitter->next_id++;
+            fprintf(emitter->file, "%s t_%d = ", c_type_name(expr->type), id);
+            c_call(emitter, expr);
+            fputs(";\n", emitter->file);
+            
+            if (emitter->hoisted_count == emitter->hoisted_capacity) {
+                emitter->hoisted_capacity = emitter->hoisted_capacity ? emitter->hoisted_capacity*2 : 16;
+                emitter->hoisted = realloc(emitter->hoisted, emitter->hoisted_capacity * sizeof(struct C_Hoisted_Call));
+                Assert(emitter->hoisted);
+            }
+            emitter->hoisted[emitter->hoisted_count++] = (struct C_Hoisted_Call){ expr, id };
+            break;
+        }
+        case EXPR_NEGATE: {
+            c_hoist_calls_in(emitter, expr->binary.left);
+            break;
+        }
+        case EXPR_BINARY: {
+            c_hoist_calls_in(emitter, expr->binary.left);
+            c_hoist_calls_in(emitter, expr->binary.right);
+            break;
+        }
+    }
+}
+
+// One call can go in line, since nothing else in the expression has side effects.
+bool
+c_needs_hoisting(struct Expr *expr) {
+    return expr && c_count_calls(expr) > 1;
+}
+
+void
+c_hoist_calls(struct C_Emitter *emitter, struct Expr *expr) {
+    emitter->hoisted_count = 0;
+    if (c_needs_hoisting(expr)) {
+        c_hoist_calls_in(emitter, expr);
+    }
+}
+
+// The type the declaration gives its variable.
+enum Type
+c_declaration_type(struct Statement *statement) {
+    if (statement->value) {
+        return statement->value->type;
+    }
+    struct Token *tok_colon = statement->token + 1;
+    return get_type(tok_colon[1].type == TOKEN_POINTER ? tok_colon + 2 : tok_colon + 1);
+}
+
+void c_statements(struct C_Emitter *emitter, struct Statement *statement);
+
+void
+c_statement(struct C_Emitter *emitter, struct Statement *statement) {
+    FILE *file = emitter->file;
+    
+    switch (statement->kind) {
+        case STATEMENT_DECLARATION: {
+            c_hoist_calls(emitter, statement->value);
+            enum Type type = c_declaration_type(statement);
+            
+            emitter->slot_symbols[statement->slot] = statement->token->symbol;
+            emitter->slot_ids[statement->slot] = emitter->next_id++;
+            
+            c_indent(emitter);
+            fprintf(file, "%s ", c_type_name(type));
+            c_variable_name(emitter, statement->slot);
+            fputs(" = ", file);
+            if (statement->value) {
+                c_expression(emitter, statement->value);
+            } else {
+                fprintf(file, "(%s){0}", c_type_name(type));
+            }
+            fputs(";\n", file);
+            break;
+        }
+        
+        case STATEMENT_ASSIGNMENT: {
+            c_hoist_calls(emitter, statement->value);
+            c_indent(emitter);
+            c_variable_name(emitter, statement->slot);
+            fputs(" = ", file);
+            c_expression(emitter, statement->value);
+            fputs(";\n", file);
+            break;
+        }
+        
+        case STATEMENT_EXPRESSION: {
+            struct Expr *value = statement->value;
+            
+            if (value->kind == EXPR_CALL && value->call.function->sys_function == SYSCALL_PRINT) {
+                struct Expr *arg = value->call.args[0];
+                c_hoist_calls(emitter, arg);
+                c_indent(emitter);
+                
+                switch (arg->type) {
+                    case TYPE_U8:     fputs("varia_print_u8(", file); break;
+                    case TYPE_S64:    fputs("varia_print_s64(", file); break;
+                    case TYPE_F64:    fputs("varia_print_f64(", file); break;
+                    case TYPE_STRING: fputs("varia_print_string(", file); break;
+                }
+                c_expression(emitter, arg);
+                fputs(");\n", file);
+            } else {
+                c_hoist_calls(emitter, value);
+                c_indent(emitter);
+                if (value->type) {
+                    fputs("(void)", file);
+                }
+                c_expression(emitter, value);
+                fputs(";\n", file);
+            }
+            break;
+        }
+        
+        case STATEMENT_RETURN: {
+            c_hoist_calls(emitter, statement->value);
+            c_indent(emitter);
+            if (statement->value) {
+                fputs("return ", file);
+                c_expression(emitter, statement->value);
+                fputs(";\n", file);
+            } else {
+                fputs("return;\n", file);
+            }
+            break;
+        }
+        
+        case STATEMENT_IF: {
+            c_hoist_calls(emitter, statement->value);
+            c_indent(emitter);
+            
+            for (;;) {
+                fputs("if (", file);
+                c_expression(emitter, statement->value);
+                fputs(") {\n", file);
+                
+                emitter->indent++;
+                c_statements(emitter, statement->body);
+                emitter->indent--;
+                
+                c_indent(emitter);
+                fputc('}', file);
+                
+                struct Statement *next = statement->else_body;
+                if (!next) break;
+                
+                // Keep "else if" chains flat, unless the next
+                // condition needs temporaries written before it.
+                if (next->kind == STATEMENT_IF && !next->next && !c_needs_hoisting(next->value)) {
+                    fputs(" else ", file);
+                    statement = next;
+                    continue;
+                }
+                
+                fputs(" else {\n", file);
+                emitter->indent++;
+                c_statements(emitter, next);
+                emitter->indent--;
+                c_indent(emitter);
+                fputc('}', file);
+                break;
+            }
+            fputc('\n', file);
+            break;
+        }
+        
+        case STATEMENT_WHILE: {
+            if (c_needs_hoisting(statement->value)) {
+                // The calls have to be made again for every check.
+                c_indent(emitter);
+                fputs("for (;;) {\n", file);
+                emitter->indent++;
+                
+                c_hoist_calls(emitter, statement->value);
+                c_indent(emitter);
+                fputs("if (!", file);
+                c_expression(emitter, statement->value);
+                fputs(") break;\n", file);
+            } else {
+                emitter->hoisted_count = 0;
+                c_indent(emitter);
+                fputs("while (", file);
+                c_expression(emitter, statement->value);
+                fputs(") {\n", file);
+                emitter->indent++;
+            }
+            
+            c_statements(emitter, statement->body);
+            
+            emitter->indent--;
+            c_indent(emitter);
+            fputs("}\n", file);
+            break;
+        }
+    }
+}
+
+void
+c_statements(struct C_Emitter *emitter, struct Statement *statement) {
+    for (; statement; statement = statement->next) {
+        c_statement(emitter, statement);
+    }
+}
+
+void
+c_function_signature(struct C_Emitter *emitter, struct Function *func) {
+    FILE *file = emitter->file;
+    
+    fprintf(file, "static %s v_%s(", c_type_name(func->return_type), func->name);
+    
+    if (!func->parameter_count) {
+        fputs("void", file);
+    }
+    for (int i = 0; i < func->parameter_count; i++) {
+        if (i) fputs(", ", file);
+        fprintf(file, "%s ", c_type_name(func->slot_types[i]));
+        c_variable_name(emitter, i);
+    }
+    fputc(')', file);
+}
+
+// Parameters are the first variables of the top scope,
+// and take the first slots.
+void
+c_name_parameters(struct C_Emitter *emitter, struct Function *func) {
+    for (int i = 0; i < func->parameter_count; i++) {
+        emitter->slot_symbols[i] = func->top_scope->variables[i].symbol;
+        emitter->slot_ids[i] = i;
+    }
+}
+
+// Writes the whole program as C to path, or to stdout if path is NULL.
+// Every function has to be type checked already.
+void
+emit_c(struct Interpreter *interp, const char *path) {
+    struct Program *program = &interp->program;
+    struct C_Emitter emitter = { .interp = interp };
+    
+    emitter.file = path ? fopen(path, "w") : stdout;
+    if (!emitter.file) {
+        Error("Couldn't open %s!\n", path);
+        exit(1);
+    }
+    
+    int max_slots = 1;
+    for (int i = 0; i < program->function_count; i++) {
+        if (program->functions[i].slot_count > max_slots) {
+            max_slots = program->functions[i].slot_count;
+        }
+    }
+    emitter.slot_symbols = calloc(max_slots, sizeof(u32));
+    emitter.slot_ids = calloc(max_slots, sizeof(int));
+    Assert(emitter.slot_symbols && emitter.slot_ids);
+    
+    fprintf(emitter.file, "// Generated from %s by varia --emit-c.\n\n", interp->tokenizer.file_name);
+    fputs(c_runtime, emitter.file);
+    
+    // Declare everything first, so they can call each other in any order.
+    fputc('\n', emitter.file);
+    for (int i = 0; i < program->function_count; i++) {
+        struct Function *func = &program->functions[i];
+        if (func->sys_function) continue;
+        
+        c_name_parameters(&emitter, func);
+        c_function_signature(&emitter, func);
+        fputs(";\n", emitter.file);
+    }
+    
+    for (int i = 0; i < program->function_count; i++) {
+        struct Function *func = &program->functions[i];
+        if (func->sys_function) continue;
+        
+        emitter.function = func;
+        emitter.next_id = func->parameter_count;
+        c_name_parameters(&emitter, func);
+        
+        fputc('\n', emitter.file);
+        c_function_signature(&emitter, func);
+        fputs(" {\n", emitter.file);
+        
+        emitter.indent = 1;
+        c_statements(&emitter, func->statements);
+        
+        // Falling off the end returns zero, like in the VM.
+        if (func->return_type) {
+            fprintf(emitter.file, "    return (%s){0};\n", c_type_name(func->return_type));
+        }
+        fputs("}\n", emitter.file);
+    }
+    
+    fputs("\nint\nmain(void) {\n    v_main();\n    return 0;\n}\n", emitter.file);
+    
+    free(emitter.slot_symbols);
+    free(emitter.slot_ids);
+    free(emitter.hoisted);
+    
+    if (path) {
+        fclose(emitter.file);
+    } else {
+        fflush(emitter.file);
+    }
+}
@@ -1,144 +1,76 @@
-struct Variable *
-program_find_variable(struct Function *curr_func, const char *name) {
-    struct Scope *scope = curr_func->current_scope;
-    while (scope) {
-        for (int i = 0; i < scope->var_count; i++) {
-            if (0==strcmp(name, (char*)scope->variables[i].name)) {
-                return &scope->variables[i];
-            }
-        }
-        scope = scope->up;
-    }
-    
-    return NULL;
-}
-
 struct Function *
-program_find_function(struct Program *program, const char *name) {
-    for (int i = 0; i < program->function_count; i++) {
-        if (0==strcmp(name, (char*)program->functions[i].name)) {
-            return &program->functions[i];
+program_find_function(struct Program *program, u32 symbol) {
+    if (!program->function_table_size) return NULL;
+    
+    u32 mask = program->function_table_size-1;
+    
+    for (u32 index = hash_symbol(symbol) & mask;
+         program->function_table[index];
+         index = (index+1) & mask)
+    {
+        struct Function *fun = &program->functions[program->function_table[index]-1];
+        if (fun->symbol == symbol) {
+            return fun;
         }
     }
     
     return NULL;
 }
 
-enum Type
-get_type(const char *name) {
-    enum Type result = 0;
+// Puts entry, an index+1 into functions, in the function table.
+void
+function_table_insert(struct Program *program, u32 entry) {
+    u32 mask = program->function_table_size-1;
+    u32 index = hash_symbol(program->functions[entry-1].symbol) & mask;
     
-    if (0==strcmp(name, "char") || 0==strcmp(name, "u8")) {
-        result = TYPE_U8;
-    } else if (0==strcmp(name, "int") || 0==strcmp(name, "i64")) {
-        result = TYPE_S64;
-    } else if (0==strcmp(name, "float") || 0==strcmp(name, "f64")) {
-        result = TYPE_F64;
-    } else if (0==strcmp(name, "string")) {
-        result = TYPE_STRING;
+    while (program->function_table[index]) {
+        index = (index+1) & mask;
     }
-    
-    return result;
+    program->function_table[index] = entry;
 }
 
-// For example,
-// converting the \n to an actual newline instead of backslash and n.
+// Doubles the function table, and puts what was in it back. Only
+// what's in the old table goes in, so functions that were never
+// registered, like the REPL's replacements, stay out of it.
 void
-parse_string(char *output_string, char *input_string) {
-    char *s = input_string;
-    u64 length = strlen(s);
-    u64 output_len = 0;
-    
-    for (u64 i = 0; i < length; i++) {
-        if (s[i] == '\\') {
-            i++;
-            switch (s[i]) {
-                case 'n': {
-                    output_string[output_len++] = '\n';
-                    break;
-                }
-                case 'r': {
-                    output_string[output_len++] = '\r';
-                    break;
-                }
-                case 't': {
-                    output_string[output_len++] = '\t';
-                    break;
-                }
-                case '\\': {
-                    output_string[output_len++] = '\\';
-                    break;
-                }
-            }
-        } else {
-            output_string[output_len++] = s[i];
-        }
-    }
-}
-
-enum Type
-get_automatic_type_literal(const char *name) {
-    if (*name == '"') {
-        return TYPE_STRING;
-    }
+program_grow_function_table(struct Program *program) {
+    u32 *old_table = program->function_table;
+    u32 old_size = program->function_table_size;
     
-    for (unsigned i = 0; i < strlen(name); i++) {
-        char c = name[i];
-        if (c == '.') {
-            return TYPE_F64;
+    program->function_table_size = old_size ? old_size*2 : 128;
+    program->function_table = calloc(program->function_table_size, sizeof(u32));
+    Assert(program->function_table);
+    
+    for (u32 i = 0; i < old_size; i++) {
+        if (old_table[i]) {
+            function_table_insert(program, old_table[i]);
         }
     }
-    
-    return TYPE_S64;
+    free(old_table);
 }
 
-enum Type
-get_automatic_type(struct Program *program, const char *name) {
-    enum Type result = 0;
-    
-    if (name[0] == '"') {
-        result = TYPE_STRING;
-        return result;
-    }
-    
-    bool is_signed = false;
-    bool is_number = true;
-    bool has_decimal = false;
-    bool is_identifier = false;
-    
-    if (name[0] == '-') {
-        is_signed = true;
-    }
-    
-    for (unsigned i = 0; i < strlen(name); i++) {
-        char c = name[i];
-        if (c == ' ' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
-            is_identifier = true;
-        } else if (c == '.') {
-            has_decimal = true;
-        } else if (!(c >= '0' && c <= '9')) {
-            is_number = false;
-        }
-    }
-    
-    // TODO: Characters (U8)
-    if (is_identifier) {
-        struct Variable *v = program_find_variable(program->current_function, name);
-        Assert(v);
-        result = v->type;
-    }  else if (has_decimal) {
-        result = TYPE_F64;
-    } else {
-        result = TYPE_S64;
+// Makes the function findable by program_find_function().
+void
+program_register_function(struct Program *program, struct Function *fun) {
+    if ((u32)(program->function_count+1)*2 > program->function_table_size) {
+        program_grow_function_table(program);
     }
-    
-    return result;
+    function_table_insert(program, (u32)(fun - program->functions + 1));
 }
 
-void
-function_setup_scope(struct Function *function) {
-    function->top_scope = calloc(1, sizeof(struct Scope));
-    function->current_scope = function->top_scope;
+// Adds a zeroed function to the end of program.functions. The pointer
+// is only good until the next one's added, since they might move.
+struct Function *
+program_new_function(struct Program *program) {
+    if (program->function_count == program->function_capacity) {
+        int old_capacity = program->function_capacity;
+        program->function_capacity = old_capacity ? old_capacity*2 : 64;
+        program->functions = realloc(program->functions, program->function_capacity * sizeof(struct Function));
+        Assert(program->functions);
+        memset(program->functions + old_capacity, 0,
+               (u64)(program->function_capacity - old_capacity) * sizeof(struct Function));
+    }
+    return &program->functions[program->function_count++];
 }
 
 u64
@@ -170,177 +102,134 @@ type_size_notstr(enum Type type) {
     return result;
 }
 
-u64
-type_size(struct Variable *v) {
-    enum Type type = v->type;
-    u64 result = 0;
-    
-    switch (type) {
-        case TYPE_STRING: {
-            Assert(((char*)v->value)[0] != '"'); // Should be snipped out by now.
-            result = strlen((char*)v->value);
-            break;
-        }
-        case TYPE_U8: {
-            result = 8;
-            break;
-        }
-        case TYPE_S64: {
-            result = 64;
-            break;
-        }
-        case TYPE_F64: {
-            result = 64;
-            break;
-        }
-    }
-    
-    result /= 8;
-    
-    Assert(result > 0);
-    
-    return result;
-}
-
-void
-print(struct Variable *v) {
-    void *ptr = v->value;
-    enum Type type = v->type;
-    
-    switch (type) {
-        case TYPE_STRING: {
-            Log("%s", (char*)ptr);
-            break;
-        }
-        
-        case TYPE_U8: {
-            putchar(*(uint8_t*)ptr);
-            break;
-        }
-        
-        case TYPE_S64: {
-            Log("%zd\n", *(s64*)ptr);
-            break;
-        }
-        
-        case TYPE_F64: {
-            Log("%lf\n", *(f64*)ptr);
-            break;
-        }
-    }
-}
-
-void *
-program_alloc(struct Program *program, u64 size) {
-    Assert((u64)(program->memory_caret - program->memory)+size < program->memory_size);
-    
-    void *result = program->memory_caret;
-    program->memory_caret += size;
-    return result;
-}
-
-struct Variable *
-program_add_variable(struct Program *program,
-                     struct Scope *scope,
-                     const char *name,
-                     enum Type type,
-                     bool is_pointer,
-                     u64 size)
-{
-    struct Variable *var = &scope->variables[scope->var_count++];
-    strcpy(var->name, name);
-    var->is_pointer = is_pointer;
-    var->type = type;
-    if (is_pointer) {
-        var->value = program_alloc(program, sizeof(u64));
-        // All pointers are u64.
-    } else {
-        var->value = program_alloc(program, size);
-    }
-    return var;
-}
-
 void
 program_setup_syscalls(struct Program *program) {
     {
-        struct Function *fun = &program->functions[program->function_count];
+        struct Function *fun = program_new_function(program);
         function_setup_scope(fun);
         strcpy(fun->name, "print");
+        fun->symbol = SYMBOL_PRINT;
         fun->sys_function = SYSCALL_PRINT;
-        program_add_variable(program,
-                             fun->top_scope,
-                             "_print_var",
-                             TYPE_S64,
-                             false,
-                             64);
+        // print() takes any type, so it has no parameter variable.
         fun->parameter_count = 1;
         
-        ++program->function_count;
+        program_register_function(program, fun);
     }
 }
 
 void
 program_setup(struct Interpreter *interp) {
-    interp->program.memory_size = Megabytes(256);
+    u64 heap_size = interp->options.heap_size ? interp->options.heap_size : HEAP_SIZE_DEFAULT;
+    if (heap_size < HEAP_SIZE_MIN) {
+        tokenizer_error(&interp->tokenizer, "The heap has to be at least %lluMB!\n",
+                        (unsigned long long)(HEAP_SIZE_MIN / Megabytes(1)));
+    }
     
-    LPVOID base_address = (LPVOID) 0;
-    interp->program.memory = VirtualAlloc(base_address,
-                                          interp->program.memory_size,
-                                          MEM_COMMIT|MEM_RESERVE,
-                                          PAGE_READWRITE);
+    // Whole steps, so the stack starts on a huge page.
+    u64 step_mask = HEAP_COMMIT_STEP-1;
+    u64 call_stack_size = (MAX_CALL_DEPTH * sizeof(struct Position) + step_mask) & ~step_mask;
+    interp->program.memory_size = heap_size & ~step_mask;
+    
+    interp->program.memory = platform_reserve_memory(interp->program.memory_size, interp->options.huge_pages);
     if (!interp->program.memory) {
-        Error("VirtualAlloc() error! Win32 Error Code: %d\n", GetLastError());
-        exit(1);
+        tokenizer_error(&interp->tokenizer, "Couldn't reserve %lluMB for the program's heap!\n",
+                        (unsigned long long)(interp->program.memory_size / Megabytes(1)));
+    }
+    
+    u8 *memory = interp->program.memory;
+    interp->program.memory_committed = memory;
+    interp->program.call_stack = (struct Position*)memory;
+    interp->program.stack = (union Value*)(memory + call_stack_size);
+    interp->program.stack_peak = interp->program.stack;
+    interp->program.stack_end = (union Value*)(memory + interp->program.memory_size - HEAP_GUARD_SIZE);
+    
+    // The start of the stack too, so small programs never have to commit more.
+    if (!program_commit_memory(&interp->program, memory + call_stack_size + HEAP_COMMIT_STEP)) {
+        tokenizer_error(&interp->tokenizer, "Couldn't allocate the program's memory!\n");
     }
     
-    interp->program.memory_caret = interp->program.memory;
+    output_setup(&interp->program.output, interp->options.flush_policy, interp->options.flush_bytes,
+                 interp->options.write, interp->options.write_data);
     
     program_setup_syscalls(&interp->program);
+    
+    interp->program.jit.enabled = JIT_SUPPORTED && !interp->options.no_jit;
+    
+    if (interp->options.profile) {
+        struct Function *print = program_find_function(&interp->program, SYMBOL_PRINT);
+        interp->program.profiler = profiler_new((int)(print - interp->program.functions));
+    }
+}
+
+void
+function_free(struct Function *fun) {
+    free(fun->bytecode.code);
+    free(fun->slot_types);
+    function_free_scopes(fun);
 }
 
 void
 program_free(struct Interpreter *interp) {
-    VirtualFree(interp->program.memory, 0, MEM_RELEASE);
-    // TODO: Free all scopes, and everything else we may have allocated.
+    for (int i = 0; i < interp->program.function_count; i++) {
+        function_free(&interp->program.functions[i]);
+    }
+    free(interp->program.functions);
+    free(interp->program.function_table);
+    arena_free(&interp->expr_arena);
+    output_free(&interp->program.output);
+    jit_free(&interp->program.jit);
+    if (interp->program.profiler) {
+        profiler_free(interp->program.profiler);
+    }
+    if (interp->program.memory) {
+        platform_free_memory(interp->program.memory, interp->program.memory_size);
+    }
 }
 
+// Fills in the function defined at tok, from its name up to the {
+// of its body. It doesn't have to be in program.functions.
 void
-program_add_function(struct Program *program, struct Token *tok) {
+function_setup(struct Interpreter *interp, struct Function *fun, struct Token *tok) {
     Assert(tok->type == TOKEN_IDENTIFIER);
     Assert(tok->identifier_type == IDENTIFIER_FUNCTION_DEF);
-    Assert(program->function_count < MAX_FUNCTIONS);
-    
-    struct Function *fun = &program->functions[program->function_count];
     
     fun->token = tok;
-    strcpy(fun->name, tok->name);
+    if (tok->length >= sizeof(fun->name)) {
+        CompileError(interp, tok, "This function's name is too long.");
+    }
+    token_name(&interp->tokenizer, tok, fun->name);
+    fun->symbol = tok->symbol;
     
     function_setup_scope(fun);
     
     // Now, we add the function parameters.
     
-    tok = tok->next->next->next->next; // Pass the :: (
+    tok += 4; // Pass the :: (
     
     if (tok->type != TOKEN_CLOSE_FUNCTION) {
         // Format of a parameter is "variable : type,"
-        Assert(tok->type == TOKEN_IDENTIFIER);
-        
         while (tok->type != TOKEN_CLOSE_FUNCTION) {
-            struct Token *type_token = tok->next->next;
-            enum Type type = get_type(type_token->name);
+            if (tok->type != TOKEN_IDENTIFIER || tok[1].type != TOKEN_COLON) {
+                CompileError1(interp, tok, "Expected a parameter of %s(), like \"name: type\".", fun->name);
+            }
+            
+            struct Token *type_token = tok + 2;
+            enum Type type = get_type(type_token);
+            if (!type) {
+                CompileError1(interp, type_token, "Unknown type for a parameter of %s()", fun->name);
+            }
             
             // We use the top scope for the function parameters,
             // since that is used globally in the function.
-            program_add_variable(program,
+            program_add_variable(fun,
                                  fun->top_scope,
-                                 tok->name,
+                                 tok->symbol,
                                  type,
-                                 false,
-                                 type_size_notstr(type));
+                                 false);
             
-            tok = type_token->next;
+            tok = type_token + 1;
             if (tok->type == TOKEN_COMMA)
-                tok = tok->next;
+                tok++;
             
             fun->parameter_count++;
         }
@@ -348,443 +237,467 @@ program_add_function(struct Program *program, struct Token *tok) {
         // We don't have any parameters.
     }
     
-    program->function_count++;
+    // "-> type" after the parameters gives the return type.
+    if (tok[1].type == TOKEN_ARROW) {
+        fun->return_type = get_type(tok + 2);
+        if (!fun->return_type) {
+            CompileError1(interp, tok + 2, "Unknown return type for %s()", fun->name);
+        }
+        tok += 2;
+    }
+    
+    fun->body = tok + 1;
+    if (fun->body->type != TOKEN_OPEN_SCOPE) {
+        CompileError1(interp, fun->body, "Expected a { to start the body of %s()", fun->name);
+    }
+}
+
+// Makes the function defined at tok findable, but leaves the rest of
+// it for function_setup(), so all of them can be set up at once.
+struct Function *
+program_declare_function(struct Interpreter *interp, struct Token *tok) {
+    struct Program *program = &interp->program;
+    struct Function *fun = program_new_function(program);
+    fun->token = tok;
+    fun->symbol = tok->symbol;
+    
+    program_register_function(program, fun);
+    return fun;
+}
+
+struct Function *
+program_add_function(struct Interpreter *interp, struct Token *tok) {
+    struct Function *fun = program_declare_function(interp, tok);
+    function_setup(interp, fun, tok);
+    return fun;
 }
 
 void
-copy_variable(struct Variable *dest, struct Variable *src) {
-    Assert(dest->type == src->type);
-    if (dest->type == TYPE_STRING) {
-        strcpy((char*)dest->value, (char*)src->value);
-    } else {
-        memcpy(dest->value, src->value, type_size(dest));
-    }
+function_setup_pass(struct Interpreter *interp, struct Function *fun) {
+    function_setup(interp, fun, fun->token);
 }
 
+void emit_function_call(struct Interpreter *interp, struct Expr *call);
+
+// Emits the code that leaves the value of the expression on the stack.
+// The types have all been worked out by the type checker.
 void
-get_variable_from_str(void *ptr, char *str, enum Type type) {
-    Assert(ptr);
-    Assert(str);
+emit_expression(struct Interpreter *interp, struct Expr *expr) {
+    struct Bytecode *bytecode = &interp->program.current_function->bytecode;
+    bool is_s64 = expr->type == TYPE_S64;
     
-    switch (type) {
-        case TYPE_STRING: {
-            // Remove surrounding ""
-            str++;
-            str[strlen(str)-1] = 0;
-            
-            parse_string((char*)ptr, str);
+    switch (expr->kind) {
+        case EXPR_CONSTANT: {
+            emit_push(bytecode, expr->value);
             break;
         }
         
-        case TYPE_U8: {
-            u8 valueu8 = (u8) atoi(str);
-            memcpy(ptr, &valueu8, type_size_notstr(type));
+        case EXPR_VARIABLE: {
+            emit(bytecode, OP_LOAD, expr->slot);
             break;
         }
-        case TYPE_F64: {
-            f64 valuesf64 = (f64) atof(str);
-            memcpy(ptr, &valuesf64, type_size_notstr(type));
+        
+        case EXPR_CALL: {
+            emit_function_call(interp, expr);
             break;
         }
-        case TYPE_S64: {
-            s64 values64 = (s64) atoi(str);
-            memcpy(ptr, &values64, type_size_notstr(type));
+        
+        case EXPR_NEGATE: {
+            emit_expression(interp, expr->binary.left);
+            emit(bytecode, is_s64 ? OP_NEGATE_S64 : OP_NEGATE_F64, 0);
+            break;
+        }
+        
+        case EXPR_BINARY: {
+            emit_expression(interp, expr->binary.left);
+            emit_expression(interp, expr->binary.right);
+            
+            bool operands_are_s64 = expr->binary.left->type == TYPE_S64;
+            
+            switch (expr->op) {
+                case TOKEN_ADD: {
+                    emit(bytecode, is_s64 ? OP_ADD_S64 : OP_ADD_F64, 0);
+                    break;
+                }
+                case TOKEN_SUBTRACT: {
+                    emit(bytecode, is_s64 ? OP_SUBTRACT_S64 : OP_SUBTRACT_F64, 0);
+                    break;
+                }
+                case TOKEN_DIVIDE: {
+                    emit(bytecode, is_s64 ? OP_DIVIDE_S64 : OP_DIVIDE_F64, 0);
+                    break;
+                }
+                case TOKEN_MULTIPLY: {
+                    emit(bytecode, is_s64 ? OP_MULTIPLY_S64 : OP_MULTIPLY_F64, 0);
+                    break;
+                }
+                
+                // These give an int, so it's the operands' type that matters.
+                case TOKEN_EQUAL_EQUAL: {
+                    emit(bytecode, operands_are_s64 ? OP_EQUAL_S64 : OP_EQUAL_F64, 0);
+                    break;
+                }
+                case TOKEN_NOT_EQUAL: {
+                    emit(bytecode, operands_are_s64 ? OP_NOT_EQUAL_S64 : OP_NOT_EQUAL_F64, 0);
+                    break;
+                }
+                case TOKEN_LESS: {
+                    emit(bytecode, operands_are_s64 ? OP_LESS_S64 : OP_LESS_F64, 0);
+                    break;
+                }
+                case TOKEN_LESS_EQUAL: {
+                    emit(bytecode, operands_are_s64 ? OP_LESS_EQUAL_S64 : OP_LESS_EQUAL_F64, 0);
+                    break;
+                }
+                case TOKEN_GREATER: {
+                    emit(bytecode, operands_are_s64 ? OP_GREATER_S64 : OP_GREATER_F64, 0);
+                    break;
+                }
+                case TOKEN_GREATER_EQUAL: {
+                    emit(bytecode, operands_are_s64 ? OP_GREATER_EQUAL_S64 : OP_GREATER_EQUAL_F64, 0);
+                    break;
+                }
+            }
+            break;
+        }
+    }
+}
+
+// Emits the arguments and the call.
+void
+emit_function_call(struct Interpreter *interp, struct Expr *call) {
+    struct Program *program = &interp->program;
+    struct Bytecode *bytecode = &program->current_function->bytecode;
+    struct Function *func = call->call.function;
+    
+    // The arguments are pushed in order, and
+    // become the first slots of the callee's frame.
+    for (int i = 0; i < call->call.arg_count; i++) {
+        emit_expression(interp, call->call.args[i]);
+    }
+    
+    switch (func->sys_function) {
+        case SYSCALL_NONE: {
+            emit_call(bytecode,
+                      (int)(func - program->functions),
+                      func->parameter_count,
+                      func->return_type != TYPE_NONE);
+            break;
+        }
+        
+        case SYSCALL_PRINT: {
+            switch (call->call.args[0]->type) {
+                case TYPE_U8:     emit(bytecode, OP_PRINT_U8, 0); break;
+                case TYPE_S64:    emit(bytecode, OP_PRINT_S64, 0); break;
+                case TYPE_F64:    emit(bytecode, OP_PRINT_F64, 0); break;
+                case TYPE_STRING: emit(bytecode, OP_PRINT_STRING, 0); break;
+            }
             break;
         }
     }
 }
 
+void compile_statements(struct Interpreter *interp, struct Statement *statement);
+
 void
-get_variable_from_literal_or_identifier(struct Interpreter *interp, void *ptr, struct Token *token) {
-    if (token->type == TOKEN_LITERAL) {
-        enum Type type = get_automatic_type(&interp->program, token->name);
+compile_statement(struct Interpreter *interp, struct Statement *statement) {
+    struct Function *func = interp->program.current_function;
+    struct Bytecode *bytecode = &func->bytecode;
+    
+#ifdef VARIA_COUNT_STATEMENTS
+    emit(bytecode, OP_STATEMENT, 0);
+#endif
+    
+    switch (statement->kind) {
+        case STATEMENT_DECLARATION:
+        case STATEMENT_ASSIGNMENT: {
+            if (statement->value) {
+                emit_expression(interp, statement->value);
+            } else {
+                // Frames aren't cleared, so zero it explicitly.
+                emit_push(bytecode, (union Value){0});
+            }
+            emit(bytecode, OP_STORE, statement->slot);
+            break;
+        }
         
-        get_variable_from_str(ptr, token->name, type);
-        //Log("New out_variable %s = %s\n", out_var->name, a->name);
-    } else if (token->type == TOKEN_IDENTIFIER) {
-        // Copy the out_variable.
-        struct Variable *var_set_to = program_find_variable(interp->program.current_function, token->name);
+        case STATEMENT_EXPRESSION: {
+            emit_expression(interp, statement->value);
+            
+            // Nobody's using the value, so throw it away.
+            if (statement->value->type) {
+                emit(bytecode, OP_POP, 0);
+            }
+            break;
+        }
         
-        Assert(var_set_to);
+        case STATEMENT_RETURN: {
+            if (statement->value) {
+                emit_expression(interp, statement->value);
+                emit(bytecode, OP_RETURN_VALUE, 0);
+            } else {
+                emit(bytecode, OP_RETURN, 0);
+            }
+            break;
+        }
         
-        if (var_set_to->type == TYPE_STRING) {
-            strcpy((char*)ptr, (char*)var_set_to->value);
-        } else {
-            memcpy(ptr, var_set_to->value, type_size(var_set_to));
+        case STATEMENT_IF: {
+            emit_expression(interp, statement->value);
+            int skip_body = emit_jump(bytecode, OP_JUMP_IF_ZERO);
+            
+            compile_statements(interp, statement->body);
+            
+            if (statement->else_body) {
+                int skip_else = emit_jump(bytecode, OP_JUMP);
+                patch_jump(bytecode, skip_body);
+                compile_statements(interp, statement->else_body);
+                patch_jump(bytecode, skip_else);
+            } else {
+                patch_jump(bytecode, skip_body);
+            }
+            break;
+        }
+        
+        case STATEMENT_WHILE: {
+            int start = bytecode->count;
+            
+            emit_expression(interp, statement->value);
+            int exit = emit_jump(bytecode, OP_JUMP_IF_ZERO);
+            
+            compile_statements(interp, statement->body);
+            emit_loop(bytecode, start);
+            
+            patch_jump(bytecode, exit);
+            break;
         }
     }
 }
 
 void
-make_sure_tokens_are_same_type(struct Interpreter *interp, struct Token *a, struct Token *b) {
-    enum Type a_type = get_automatic_type(&interp->program, a->name);
-    enum Type b_type = get_automatic_type(&interp->program, b->name);
-    
-    if (a_type != b_type) {
-        CompileError(interp, a, "Expression must have the same type for both operands.");
+compile_statements(struct Interpreter *interp, struct Statement *statement) {
+    for (; statement; statement = statement->next) {
+        compile_statement(interp, statement);
     }
 }
 
-// expr - Pointer to the start of the expression
-// token_count - How many tokens do the expression take?
+// Lowers the type checked statements of a function into its bytecode.
 void
-evaluate_expression(struct Interpreter *interp,
-                    enum Type output_type,
-                    struct Token *expr,
-                    int token_count,
-                    struct Variable *output_var)
-{
-    // tok_1 operation tok_2 <- This is the only valid expression here.
-    Assert(token_count == 3);
+compile_function(struct Interpreter *interp, struct Function *func) {
+    // Its statements are gone once it's been compiled, so it can't be again.
+    Assert(func->bytecode.count == 0);
+    interp->program.current_function = func;
     
-    Assert(output_var);
+    compile_statements(interp, func->statements);
     
-    if (output_type == 0) {
-        Assert(output_var->type == 0); // Must not be set yet.
-        Assert(output_var->value == NULL); // Must not be allocated as yet.
+    // Falling off the end returns zero, if we have to return something.
+    if (func->return_type) {
+        emit_push(&func->bytecode, (union Value){0});
+        emit(&func->bytecode, OP_RETURN_VALUE, 0);
+    } else {
+        emit(&func->bytecode, OP_RETURN, 0);
+    }
+}
+
+// Including the ones in the blocks of ifs and whiles.
+int
+count_statements(struct Statement *statement) {
+    int count = 0;
+    for (; statement; statement = statement->next) {
+        count += 1 + count_statements(statement->body) + count_statements(statement->else_body);
+    }
+    return count;
+}
+
+// Once every function is compiled, the trees aren't needed, and the
+// statements pointing into them are cleared so nothing can use them.
+void
+program_free_trees(struct Interpreter *interp) {
+    arena_reset(&interp->expr_arena);
+    for (int i = 0; i < interp->program.function_count; i++) {
+        interp->program.functions[i].statements = NULL;
+    }
+}
+
+// Setting up, resolving, type checking and compiling a function only
+// writes to that function, so each of those passes is run over all the
+// functions at once. Every thread has its own shallow copy of the
+// interpreter, with its own arena for the trees, its own current_function
+// and its own place for errors to go. The functions are shared.
+//
+// A function stops at its first error, and once they're all done, only
+// the error of the first function in the program is shown, so what's
+// reported is the same as doing them one after the other.
+typedef void Function_Pass(struct Interpreter *interp, struct Function *func);
+
+struct Function_Pass_Job {
+    struct Interpreter *interp;
+    struct Interpreter *workers; // One for each thread.
+    Function_Pass *pass;
+    char **errors; // For each function, NULL if it didn't have one.
+};
+
+void
+function_pass_work(void *data, int index, int thread) {
+    struct Function_Pass_Job *job = data;
+    struct Interpreter *worker = &job->workers[thread];
+    struct Function *func = &job->interp->program.functions[index];
+    
+    if (func->sys_function) return;
+    
+    jmp_buf on_error;
+    worker->tokenizer.on_error = &on_error;
+    if (setjmp(on_error)) {
+        job->errors[index] = malloc(ERROR_MESSAGE_SIZE);
+        Assert(job->errors[index]);
+        memcpy(job->errors[index], worker->tokenizer.error_message, ERROR_MESSAGE_SIZE);
+        return;
     }
     
-    struct Token *a = expr;
-    struct Token *operation = a->next;
-    struct Token *b = operation->next;
-    
-    make_sure_tokens_are_same_type(interp, a, b);
-    
-    if (output_type == 0) {
-        output_type = get_automatic_type(&interp->program, a->name);
-    } else if (output_type != get_automatic_type(&interp->program, a->name)) {
-        CompileError(interp, a, "Type of variable is not equal to the expression return type");
+    job->pass(worker, func);
+}
+
+// Each pass is one job for the thread pool, so the threads are only
+// started once, however many passes and programs there are. Below this
+// many functions, waking them still costs more than they save.
+#define FUNCTION_PASS_PARALLEL_MIN 64
+
+void
+run_function_pass(struct Interpreter *interp, Function_Pass *pass) {
+    int function_count = interp->program.function_count;
+    int thread_count = 1;
+    if (function_count >= FUNCTION_PASS_PARALLEL_MIN) {
+        thread_count = platform_thread_count(function_count);
     }
     
-    output_var->type = output_type;
+    struct Interpreter *workers = malloc(thread_count * sizeof(struct Interpreter));
+    char *messages = malloc((u64)thread_count * ERROR_MESSAGE_SIZE);
+    char **errors = calloc(function_count, sizeof(char*));
+    Assert(workers && messages && errors);
     
-    if (!output_var->value) {
-        u64 size = type_size_notstr(output_var->type);
-        output_var->value = program_alloc(&interp->program, size);
+    for (int i = 0; i < thread_count; i++) {
+        workers[i] = *interp;
+        workers[i].expr_arena = (struct Arena){0};
+        workers[i].tokenizer.error_message = messages + (u64)i * ERROR_MESSAGE_SIZE;
     }
     
-    s64 a_s64 = 0, b_s64 = 0;
-    f64 a_f64 = 0, b_f64 = 0;
+    struct Function_Pass_Job job = { interp, workers, pass, errors };
+    platform_parallel_for(function_count, thread_count, function_pass_work, &job);
     
-    if (output_type == TYPE_S64) {
-        get_variable_from_literal_or_identifier(interp, &a_s64, a);
-        get_variable_from_literal_or_identifier(interp, &b_s64, b);
-    } else if (output_type == TYPE_F64) {
-        get_variable_from_literal_or_identifier(interp, &a_f64, a);
-        get_variable_from_literal_or_identifier(interp, &b_f64, b);
+    // The trees have to last until the functions are compiled.
+    for (int i = 0; i < thread_count; i++) {
+        arena_take(&interp->expr_arena, &workers[i].expr_arena);
     }
     
-    switch (operation->type) {
-        case TOKEN_ADD: {
-            if (output_type == TYPE_S64) {
-                s64 result = a_s64 + b_s64;
-                *(s64*)output_var->value = result;
-            } else if (output_type == TYPE_F64) {
-                f64 result = a_f64 + b_f64;
-                *(f64*)output_var->value = result;
-            }
-            break;
-        }
-        case TOKEN_SUBTRACT: {
-            if (output_type == TYPE_S64) {
-                s64 result = a_s64 - b_s64;
-                *(s64*)output_var->value = result;
-            } else if (output_type == TYPE_F64) {
-                f64 result = a_f64 - b_f64;
-                *(f64*)output_var->value = result;
-            }
-            break;
-        }
-        case TOKEN_DIVIDE: {
-            if (output_type == TYPE_S64) {
-                s64 result = a_s64 / b_s64;
-                *(s64*)output_var->value = result;
-            } else if (output_type == TYPE_F64) {
-                f64 result = a_f64 / b_f64;
-                *(f64*)output_var->value = result;
-            }
-            break;
-        }
-        case TOKEN_MULTIPLY: {
-            if (output_type == TYPE_S64) {
-                s64 result = a_s64 * b_s64;
-                *(s64*)output_var->value = result;
-            } else if (output_type == TYPE_F64) {
-                f64 result = a_f64 * b_f64;
-                *(f64*)output_var->value = result;
-            }
-            break;
+    char first_error[ERROR_MESSAGE_SIZE] = "";
+    for (int i = 0; i < function_count; i++) {
+        if (errors[i] && !first_error[0]) {
+            memcpy(first_error, errors[i], ERROR_MESSAGE_SIZE);
         }
+        free(errors[i]);
+    }
+    
+    free(errors);
+    free(messages);
+    free(workers);
+    
+    if (first_error[0]) {
+        tokenizer_error(&interp->tokenizer, "%s", first_error);
     }
 }
 
-void
-handle_variable(struct Interpreter *interp, struct Token **tok) {
-    struct Token *tok_variable_name = *tok;
+// Sets up the program, and gets all of its functions as far as being
+// type checked, which is all that emit_c() needs. Returns main().
+// Errors go through the tokenizer, so they only come back here if
+// tokenizer.on_error is set, and then program_free() cleans up.
+struct Function *
+program_check(struct Interpreter *interp) {
+    program_setup(interp);
     
-    struct Function *current_function = interp->program.current_function;
+    int main_index = -1;
+    struct Tokenizer *tokenizer = &interp->tokenizer;
     
-    if ((*tok)->next->type == TOKEN_COLON) {
-        bool is_pointer = (*tok)->next->next->type == TOKEN_POINTER;
-        
-        struct Token *tok_colon, *tok_ptr, *tok_type, *tok_equals, *tok_literal;
-        
-        tok_colon = (*tok)->next;
-        if (is_pointer) {
-            tok_ptr = tok_colon->next;
-            tok_type = tok_ptr->next;
-        } else {
-            tok_type = tok_colon->next;
-        }
-        
-        tok_equals = tok_type->next;
-        tok_literal = tok_equals->next;
-        
-        bool is_automatic = false;
-        
-        if (is_automatic && tok_equals->next->type == TOKEN_ADDRESS) {
-            CompileError(interp, *tok, "Must declare specifically the type of a pointer.");
-        }
-        
-        if (tok_colon->type == TOKEN_COLON && tok_colon->next->type == TOKEN_EQUAL) {
-            is_automatic = true;
-            tok_type = NULL;
-            tok_equals = tok_colon->next;
-            tok_literal = tok_equals->next;
-        }
-        
-        // We're doing a variable declaration
-        enum Type type = 0;
-        
-        // Is the part after the equals sign an expression?
-        bool is_expression = tok_literal->next->type != TOKEN_END_STATEMENT;
-        
-        if (!is_automatic) {
-            type = get_type(tok_type->name);
-        } else {
-            // We can't figure out the type if it's an expression.
-            if (!is_expression) {
-                type = get_automatic_type(&interp->program, tok_literal->name);
-            }
-        }
-        
-        u64 size = 0;
-        if (type == TYPE_NONE) {
-            // ...
-        } else if (type == TYPE_STRING && tok_equals->type == TOKEN_EQUAL) {
-            size = strlen(tok_literal->name) - 2 + 1; // -2 for the surrounding "" and +1 for the null terminator.
-        } else if (type == TYPE_STRING) {
-            CompileError(interp, *tok, "Must initialize a string to something.");
-        } else {
-            size = type_size_notstr(type);
-        }
-        
-        *tok = tok_equals;
-        
-        // We're initializing as well.
-        if ((*tok)->type == TOKEN_EQUAL) {
-            if (is_expression) {
-                // program_add_variable won't work for us here because
-                // we don't know the type yet.
-                struct Scope *scope = current_function->current_scope;
-                struct Variable *var = &scope->variables[scope->var_count++];
-                var->is_pointer = is_pointer;
-                strcpy(var->name, tok_variable_name->name);
-                evaluate_expression(interp, type, tok_literal, 3, var);
-            } else {
-                struct Variable *var = program_add_variable(&interp->program,
-                                                            current_function->current_scope,
-                                                            tok_variable_name->name,
-                                                            type,
-                                                            is_pointer,
-                                                            size);
-                                
-                // Get the value from the literal.
-                if (tok_literal->type == TOKEN_LITERAL) {
-                    get_variable_from_str(var->value, tok_literal->name, type);
-                    //Log("New variable %s = %s\n", var->name, tok_literal->name);
-                } else if (tok_literal->type == TOKEN_IDENTIFIER) {
-                    // Copy the variable.
-                    struct Variable *var_set_to = program_find_variable(current_function, tok_literal->name);
-                    copy_variable(var, var_set_to);
-                }
-            }
-        }
-        
-        // We're at the semicolon now.
-        *tok=(*tok)->next;
-    } else if ((*tok)->next->type == TOKEN_EQUAL) {
-        struct Token *tok_equals = tok_variable_name->next;
-        struct Token *tok_literal = tok_equals->next;
-        
-        struct Variable *v = program_find_variable(current_function,
-                                                   tok_variable_name->name);
-        if (!v) {
-            CompileError1(interp, tok_variable_name,
-                          "%s is not defined", tok_variable_name->name);
-        }
-        Assert(v); // Make sure it's declared.
-        
-        bool is_expression = tok_literal->next->type != TOKEN_END_STATEMENT;
-        
-        if (is_expression) {
-            evaluate_expression(interp, v->type, tok_literal, 3, v);
-        } else {
-            get_variable_from_str(v->value, tok_literal->name, v->type);
+    // Firstly, tag all functions. The tokenizer already found them.
+    // They can move while they're being added, so main() is kept as an index.
+    for (int i = 0; i < tokenizer->function_def_count; i++) {
+        struct Token *tok = &tokenizer->tokens[tokenizer->function_defs[i]];
+        program_declare_function(interp, tok);
+        if (tok->symbol == SYMBOL_MAIN) {
+            main_index = interp->program.function_count-1;
         }
     }
+    
+    // Their parameters and return types, which calls are checked against.
+    run_function_pass(interp, function_setup_pass);
+    
+    if (main_index < 0) {
+        tokenizer_error(tokenizer, "Main function was not defined!\n");
+    }
+    struct Function *main_function = &interp->program.functions[main_index];
+    
+    // Give every variable its slot, before we compile anything.
+    run_function_pass(interp, resolve_function);
+    
+    // Then check all of them, now that every
+    // function we could call is known.
+    run_function_pass(interp, typecheck_function);
+    
+    return main_function;
 }
 
-// Runs the actual program.
+// Runs main(), then sends out whatever it printed. Runtime
+// errors only come back here if program.on_error is set.
 void
-interpret(struct Tokenizer tokenizer) {
+program_run(struct Program *program, struct Function *main_function) {
+    vm_call(program, main_function, program->stack);
+    output_flush(&program->output);
+}
+
+// Compiles and runs the actual program.
+// stats can be NULL if you don't care how long it took.
+void
+interpret(struct Tokenizer tokenizer, struct Options options, struct Stats *stats) {
     struct Interpreter interp = {0};
     
+    interp.options = options;
     interp.tokenizer = tokenizer;
     
-    program_setup(&interp);
+    u64 compile_start = platform_nanoseconds();
     
-    struct Function *main_function = NULL;
+    struct Function *main_function = program_check(&interp);
     
-    // Firstly, tag all functions.
-    for (struct Token *tok = tokenizer.token_start; tok; tok = tok->next) {
-        if (tok->identifier_type == IDENTIFIER_FUNCTION_DEF) {
-            program_add_function(&interp.program, tok);
-            if (0==strcmp(tok->name, "main")) {
-                main_function = &interp.program.functions[interp.program.function_count-1];
-            }
-        }
+    if (options.emit_c) {
+        emit_c(&interp, options.emit_c_path);
+        program_free(&interp);
+        return;
     }
     
-    if (!main_function) {
-        Error("Main function was not defined!\n");
-        program_free(&interp);
-        exit(1);
+    // Nothing can go wrong from here on, so just emit the code.
+    run_function_pass(&interp, compile_function);
+    
+    if (stats) {
+        stats->statement_count = 0;
+        for (int i = 0; i < interp.program.function_count; i++) {
+            stats->statement_count += count_statements(interp.program.functions[i].statements);
+        }
     }
+    program_free_trees(&interp);
     
-    struct Token *tok = main_function->token;
-    interp.program.current_function = main_function;
+    u64 run_start = platform_nanoseconds();
     
-    // Start after the {
-    while (tok->type != TOKEN_OPEN_SCOPE) tok=tok->next;
-    tok=tok->next;
+    // This counts the output as part of the run.
+    program_run(&interp.program, main_function);
     
-    while (tok) {
-        if (tok->type == TOKEN_CLOSE_SCOPE) {
-            if (interp.program.call_stack_count) {
-                struct Position pos = interp.program.call_stack[--interp.program.call_stack_count];
-                tok = pos.tok;
-                interp.program.current_function = pos.func;
-            }
-        } else if (tok->type == TOKEN_IDENTIFIER) {
-            switch (tok->identifier_type) {
-                case IDENTIFIER_VARIABLE_OR_TYPE: {
-                    handle_variable(&interp, &tok);
-                    break;
-                }
-                
-                case IDENTIFIER_FUNCTION_CALL: {
-                    struct Function *func = program_find_function(&interp.program, tok->name);
-                    
-                    struct Token *function_start_token = tok;
-                    
-                    tok = tok->next->next;
-                    
-                    int i = 0;
-                    
-                    // Ensure that we have the correct amount of parameters.
-                    while (tok->type != TOKEN_CLOSE_FUNCTION) {
-                        struct Token *param_tok = tok;
-                        
-                        // Note:
-                        //   To get parameters, we simply index
-                        //   into the variables array since the
-                        //   first `parameter_count` members
-                        //   of the variables in that is always
-                        //   the parameters.
-                        struct Variable *param =
-                            &func->top_scope->variables[i];
-                        
-                        if (param_tok->type == TOKEN_IDENTIFIER) {
-                            struct Variable *v = NULL;
-                            v = program_find_variable(interp.program.current_function, param_tok->name);
-                            
-                            if (!v) {
-                                CompileError1(&interp, param_tok, "%s was not defined", param_tok->name);
-                            }
-                            
-                            // Special case for Print: make the variable
-                            // type dynamically the same as the input.
-                            if (func->sys_function == SYSCALL_PRINT) {
-                                // Print doesn't take more than one parameter.
-                                if (i > 0) {
-                                    CompileError(&interp, param_tok, "print() only takes one parameter");
-                                }
-                                param->type = v->type;
-                            }
-                            
-                            copy_variable(param, v);
-                            
-                            //print(func->parameters[i]);
-                        } else if (param_tok->type == TOKEN_LITERAL) {
-                            // We can just copy this data into
-                            // the function parameter.
-                            
-                            // Special case for Print: make the variable
-                            // type dynamically the same as the input.
-                            if (func->sys_function == SYSCALL_PRINT) {
-                                param->type = get_automatic_type(&interp.program, param_tok->name);
-                            }
-                            
-                            get_variable_from_str(param->value, param_tok->name, param->type);
-                            //Log("Set value for parameter to %s\n", param_tok->name);
-                        } else {
-                            Assert(0);
-                        }
-                        
-                        tok = param_tok->next;
-                        if (tok->type == TOKEN_COMMA) {
-                            tok = tok->next;
-                        }
-                        
-                        i++;
-                    }
-                    
-                    if (i != func->parameter_count) {
-                        // char outstr[128] = {0};
-                        // sprintf(outstr, "Function %s takes %d arguments, not %d!\n", func->name, func->parameter_count, i);
-                        CompileError1(&interp, function_start_token, "Function %s does not take that amount of arguments!", func->name);
-                    }
-                    
-                    if (func) {
-                        if (func->sys_function) {
-                            switch (func->sys_function) {
-                                case SYSCALL_PRINT: {
-                                    print(&func->top_scope->variables[0]);
-                                    tok = tok->next->next;
-                                    continue;
-                                }
-                            }
-                        } else {
-                            interp.program.call_stack[interp.program.call_stack_count++] = (struct Position){
-                                tok->next,
-                                interp.program.current_function
-                            };
-                            tok = func->token;
-                            interp.program.current_function = func;
-                        }
-                        
-                        // Start after the {
-                        while (tok->type != TOKEN_OPEN_SCOPE) tok = tok->next;
-                    }
-                    break;
-                }
-                
-            }
-        }
-        tok = tok->next;
+    if (stats) {
+        stats->compile_ns = run_start - compile_start;
+        stats->run_ns = platform_nanoseconds() - run_start;
+        stats->statements_run = interp.program.statements_run;
+        
+        stats->memory_used = (u64)((u8*)interp.program.stack_peak - (u8*)interp.program.stack);
+    }
+    
+    if (interp.program.profiler) {
+        profile_report(interp.program.profiler, &interp.program, options.profile_path);
     }
     
     program_free(&interp);
 }
-
@@ -1,6 +1,11 @@
-#define MAX_VARIABLES 1024
-#define MAX_FUNCTIONS 1024
 #define MAX_FUNCTION_PAREMETERS 8
+#define MAX_CALL_DEPTH 65536
+
+// The program's heap holds the call stack and the stack.
+#define HEAP_SIZE_DEFAULT Megabytes(256)
+#define HEAP_SIZE_MIN Megabytes(8)
+#define HEAP_COMMIT_STEP Megabytes(2) // A huge page, and a multiple of any page size.
+#define HEAP_GUARD_SIZE Kilobytes(64)
 
 enum Type {
     TYPE_NONE,
@@ -15,48 +20,135 @@ enum SysCall {
     SYSCALL_PRINT
 };
 
+// Only used while resolving. After that, variables are just slots.
 struct Variable {
-    char name[64];
-    enum Type type;
+    u32 symbol;
     bool is_pointer;
-    void *value; // Pointer into program.memory. If the variable is a pointer, this becomes a u64.
+    int slot; // Index into the function's slots.
 };
 
 struct Scope {
-    struct Variable variables[MAX_VARIABLES];
-    int var_count;
+    // Grows with what's declared in the scope, so most of them stay tiny.
+    struct Variable *variables;
+    int var_count, var_capacity;
+    
+    // Open addressing on the symbol ID, twice as big as variables.
+    // Holds an index+1 into variables, 0 means empty.
+    u32 *variable_table;
+    u32 table_size; // A power of two, or 0 before the first variable.
+    
+    int first_slot; // Slots from here on are handed back when the scope ends.
+    
+    // down is kept after the scope ends, so the next
+    // block at this depth reuses it instead of allocating.
     struct Scope *down, *up;
 };
 
 struct Function {
     char name[64];
+    u32 symbol;
     enum SysCall sys_function;
     int parameter_count;
+    enum Type return_type; // TYPE_NONE if it doesn't return anything.
     
     struct Scope *top_scope, *current_scope;
     
     struct Token *token; // The identifier of the function name
+    struct Token *body;  // The { the body starts at.
+    
+    struct Statement *statements; // Filled in by typecheck_function().
+    struct Bytecode bytecode;
+    
+    int call_count;       // Until it's compiled.
+    Jit_Function *native; // NULL until the JIT has compiled it.
+    bool jit_failed;      // Don't try compiling it again.
+    
+    // The frame layout. The first `parameter_count` slots are the parameters.
+    // Blocks that don't overlap share slots, so slot_count is the most
+    // that are live at once, and live_slot_count is only used while resolving.
+    enum Type *slot_types;
+    int slot_count, slot_capacity;
+    int live_slot_count;
 };
 
 struct Position {
-    struct Token *tok;
-    struct Function *func; // The function tok is in.
+    struct Instruction *ip;
+    struct Function *func; // The function ip is in.
+    union Value *frame;    // func's slots.
 };
 
 struct Program {
+    // The heap: the call stack, then the stack, then a guard that's never
+    // committed, so running off the end faults instead of carrying on.
+    // All of it's reserved up front, but it's only committed as it's used.
     u8 *memory;
-    u8 *memory_caret;
+    u8 *memory_committed; // Up to here.
     u64 memory_size;
     
-    struct Function functions[MAX_FUNCTIONS];
+    // It's a pointer, so the copies of the interpreter that compile
+    // functions at the same time share it. It grows as functions are
+    // declared, so a pointer to one is only good until the next is added.
+    struct Function *functions;
     struct Function *current_function;
-    int function_count;
+    int function_count, function_capacity;
+    
+    // Like Scope.variable_table, for the functions. It's kept at
+    // least twice as big as function_count, so probes stay short.
+    u32 *function_table;
+    u32 function_table_size; // A power of two, or 0 before the first function.
     
-    struct Position call_stack[MAX_FUNCTIONS];
+    // Both of these are carved out of program.memory.
+    struct Position *call_stack; // MAX_CALL_DEPTH entries, committed from the start.
     int call_stack_count;
+    int native_depth; // vm_call()s that haven't returned. These count towards MAX_CALL_DEPTH too.
+    union Value *stack, *stack_end;
+    union Value *stack_peak; // The highest a frame has reached.
+    
+    struct Output output; // Where print() goes.
+    
+    struct Profiler *profiler; // NULL unless we're run with --profile.
+    u64 statements_run; // Only counted when built with VARIA_COUNT_STATEMENTS.
+    struct Jit jit;
+    
+    // Runtime errors longjmp here instead of exiting, if it's set.
+    jmp_buf *on_error;
+    
+    // And they're written here instead of to stderr, if it's set.
+    // It holds ERROR_MESSAGE_SIZE chars.
+    char *error_message;
+};
+
+// Set from the command line.
+struct Options {
+    enum Flush_Policy flush_policy;
+    u64 flush_bytes; // 0 for the default.
+    
+    bool profile;
+    const char *profile_path; // Where the folded stacks go.
+    
+    bool no_jit; // Interpret everything, for debugging.
+    
+    u64 heap_size;   // How much address space the heap reserves. 0 for HEAP_SIZE_DEFAULT.
+    bool huge_pages; // Ask for transparent huge pages for the heap.
+    
+    bool emit_c;             // Write the program out as C instead of running it.
+    const char *emit_c_path; // NULL for stdout.
+    
+    Output_Write *write; // Where print() goes. NULL for stdout.
+    void *write_data;
+};
+
+// What a run cost, for the benchmarks.
+struct Stats {
+    u64 compile_ns, run_ns;
+    int statement_count;  // In the program.
+    u64 statements_run;   // While it ran, including every time around a loop.
+    u64 memory_used; // Of the stack, at its peak.
 };
 
 struct Interpreter {
+    struct Options options;
     struct Tokenizer tokenizer;
     struct Program program;
+    struct Arena expr_arena;
 };
@@ -0,0 +1,415 @@
+// Register use in the generated code:
+//
+//   rbx   The frame, so slot and stack entry n is at [rbx + n*8].
+//   r12   The program, for calling back into C.
+//   rax, rcx, rdx, rsi, rdi, xmm0   Scratch.
+//
+// The VM's value stack is never kept in registers. The stack depth
+// at every instruction is known when compiling, so every push and pop
+// becomes a load or store at a fixed offset from rbx.
+
+enum Jit_Register {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+};
+
+void
+jit_byte(struct Jit *jit, u8 byte) {
+    if (jit->buffer_length == jit->buffer_capacity) {
+        jit->buffer_capacity = jit->buffer_capacity ? jit->buffer_capacity*2 : Kilobytes(16);
+        jit->buffer = realloc(jit->buffer, jit->buffer_capacity);
+        Assert(jit->buffer);
+    }
+    jit->buffer[jit->buffer_length++] = byte;
+}
+
+void
+jit_bytes(struct Jit *jit, const u8 *bytes, int count) {
+    for (int i = 0; i < count; i++) {
+        jit_byte(jit, bytes[i]);
+    }
+}
+
+void
+jit_u32(struct Jit *jit, u32 value) {
+    for (int i = 0; i < 4; i++) {
+        jit_byte(jit, (u8)(value >> (i*8)));
+    }
+}
+
+void
+jit_u64(struct Jit *jit, u64 value) {
+    jit_u32(jit, (u32)value);
+    jit_u32(jit, (u32)(value >> 32));
+}
+
+// Emits an instruction whose memory operand is [rbx + position*8],
+// with `reg` in the ModRM reg field (a register, or part of the opcode).
+void
+jit_frame_operand(struct Jit *jit, const u8 *opcode, int opcode_length, int reg, int position) {
+    jit_bytes(jit, opcode, opcode_length);
+    jit_byte(jit, (u8)(0x80 | reg << 3 | RBX)); // [rbx + disp32]
+    jit_u32(jit, (u32)(position * 8));
+}
+
+#define JitFrameOperand(jit, reg, position, ...) \
+    jit_frame_operand(jit, (const u8[]){__VA_ARGS__}, sizeof((const u8[]){__VA_ARGS__}), reg, position)
+
+void jit_load_rax(struct Jit *jit, int position)   { JitFrameOperand(jit, RAX, position, 0x48, 0x8B); }
+void jit_load_rcx(struct Jit *jit, int position)   { JitFrameOperand(jit, RCX, position, 0x48, 0x8B); }
+void jit_store_rax(struct Jit *jit, int position)  { JitFrameOperand(jit, RAX, position, 0x48, 0x89); }
+void jit_lea_rdx(struct Jit *jit, int position)    { JitFrameOperand(jit, RDX, position, 0x48, 0x8D); }
+void jit_load_xmm0(struct Jit *jit, int position)  { JitFrameOperand(jit, 0, position, 0xF2, 0x0F, 0x10); }
+void jit_store_xmm0(struct Jit *jit, int position) { JitFrameOperand(jit, 0, position, 0xF2, 0x0F, 0x11); }
+void jit_ucomisd(struct Jit *jit, int position)    { JitFrameOperand(jit, 0, position, 0x66, 0x0F, 0x2E); }
+
+// Calls a C function with program as the first argument.
+// The others have to be in esi and rdx already.
+void
+jit_call_helper(struct Jit *jit, void *helper) {
+    jit_bytes(jit, (const u8[]){0x4C, 0x89, 0xE7}, 3); // mov rdi, r12
+    jit_bytes(jit, (const u8[]){0x48, 0xB8}, 2);       // mov rax, helper
+    jit_u64(jit, (u64)(uintptr_t)helper);
+    jit_bytes(jit, (const u8[]){0xFF, 0xD0}, 2);       // call rax
+}
+
+void
+jit_mov_esi(struct Jit *jit, u32 value) {
+    jit_byte(jit, 0xBE);
+    jit_u32(jit, value);
+}
+
+void
+jit_epilogue(struct Jit *jit) {
+    jit_bytes(jit, (const u8[]){
+        0x48, 0x83, 0xC4, 0x08, // add rsp, 8
+        0x41, 0x5C,             // pop r12
+        0x5B,                   // pop rbx
+        0xC3,                   // ret
+    }, 8);
+}
+
+// Native code calls these.
+
+void
+jit_call(struct Program *program, int function_index, union Value *frame) {
+    vm_call(program, &program->functions[function_index], frame);
+}
+
+void
+jit_print(struct Program *program, int type, union Value *value) {
+    vm_print(program, program->profiler, (enum Type)type, *value);
+}
+
+// A rel32 in the buffer that has to point at an instruction.
+struct Jit_Patch {
+    u64 at;     // Of the rel32.
+    int target; // Instruction index, or -1 for the division by zero error.
+};
+
+// Returns false if there's no room left for it,
+// or it has an instruction we don't know.
+bool
+jit_compile(struct Program *program, struct Function *function) {
+    struct Jit *jit = &program->jit;
+    struct Bytecode *bytecode = &function->bytecode;
+    
+    jit->buffer_length = 0;
+    
+    // Where each instruction starts in the buffer, plus where the code ends.
+    u64 *offsets = malloc((bytecode->count + 1) * sizeof(u64));
+    struct Jit_Patch *patches = malloc((bytecode->count + 1) * sizeof(struct Jit_Patch));
+    Assert(offsets && patches);
+    int patch_count = 0;
+    
+    jit_bytes(jit, (const u8[]){
+        0x53,                   // push rbx
+        0x41, 0x54,             // push r12
+        0x48, 0x83, 0xEC, 0x08, // sub rsp, 8, so calls have rsp 16 byte aligned
+        0x48, 0x89, 0xFB,       // mov rbx, rdi
+        0x49, 0x89, 0xF4,       // mov r12, rsi
+    }, 13);
+    
+    int depth = 0; // Of the VM's stack, before each instruction.
+    
+    for (int i = 0; i < bytecode->count; i++) {
+        struct Instruction *instruction = &bytecode->code[i];
+        offsets[i] = jit->buffer_length;
+        
+        // Positions of the top two stack entries.
+        int top = function->slot_count + depth - 1;
+        int below = top - 1;
+        
+        switch (instruction->op) {
+            case OP_PUSH: {
+                jit_bytes(jit, (const u8[]){0x48, 0xB8}, 2); // mov rax, imm64
+                jit_u64(jit, (u64)instruction->imm.s64);
+                jit_store_rax(jit, top + 1);
+                break;
+            }
+            case OP_LOAD: {
+                jit_load_rax(jit, instruction->operand);
+                jit_store_rax(jit, top + 1);
+                break;
+            }
+            case OP_STORE: {
+                jit_load_rax(jit, top);
+                jit_store_rax(jit, instruction->operand);
+                break;
+            }
+            case OP_POP: {
+                break;
+            }
+            case OP_STATEMENT: {
+                jit_bytes(jit, (const u8[]){0x49, 0xFF, 0x84, 0x24}, 4); // inc qword [r12 + disp32]
+                jit_u32(jit, (u32)offsetof(struct Program, statements_run));
+                break;
+            }
+            
+            case OP_ADD_S64: case OP_SUBTRACT_S64: case OP_MULTIPLY_S64: {
+                jit_load_rax(jit, below);
+                switch (instruction->op) {
+                    case OP_ADD_S64:      JitFrameOperand(jit, RAX, top, 0x48, 0x03); break;
+                    case OP_SUBTRACT_S64: JitFrameOperand(jit, RAX, top, 0x48, 0x2B); break;
+                    case OP_MULTIPLY_S64: JitFrameOperand(jit, RAX, top, 0x48, 0x0F, 0xAF); break;
+                }
+                jit_store_rax(jit, below);
+                break;
+            }
+            case OP_DIVIDE_S64: {
+                jit_load_rax(jit, below);
+                jit_load_rcx(jit, top);
+                jit_bytes(jit, (const u8[]){0x48, 0x85, 0xC9, 0x0F, 0x84}, 5); // test rcx, rcx; jz
+                patches[patch_count++] = (struct Jit_Patch){ jit->buffer_length, -1 };
+                jit_u32(jit, 0);
+                // INT64_MIN / -1 traps in idiv, so x / -1 is a negate, like in the VM.
+                jit_bytes(jit, (const u8[]){
+                    0x48, 0x83, 0xF9, 0xFF, // cmp rcx, -1
+                    0x75, 0x05,             // jne over the negate
+                    0x48, 0xF7, 0xD8,       // neg rax
+                    0xEB, 0x05,             // jmp over the divide
+                    0x48, 0x99,             // cqo
+                    0x48, 0xF7, 0xF9,       // idiv rcx
+                }, 16);
+                jit_store_rax(jit, below);
+                break;
+            }
+            
+            case OP_ADD_F64: case OP_SUBTRACT_F64: case OP_MULTIPLY_F64: case OP_DIVIDE_F64: {
+                jit_load_xmm0(jit, below);
+                switch (instruction->op) {
+                    case OP_ADD_F64:      JitFrameOperand(jit, 0, top, 0xF2, 0x0F, 0x58); break;
+                    case OP_SUBTRACT_F64: JitFrameOperand(jit, 0, top, 0xF2, 0x0F, 0x5C); break;
+                    case OP_MULTIPLY_F64: JitFrameOperand(jit, 0, top, 0xF2, 0x0F, 0x59); break;
+                    case OP_DIVIDE_F64:   JitFrameOperand(jit, 0, top, 0xF2, 0x0F, 0x5E); break;
+                }
+                jit_store_xmm0(jit, below);
+                break;
+            }
+            
+            case OP_NEGATE_S64: {
+                JitFrameOperand(jit, 3, top, 0x48, 0xF7); // neg qword
+                break;
+            }
+            case OP_NEGATE_F64: {
+                jit_load_rax(jit, top);
+                jit_bytes(jit, (const u8[]){0x48, 0x0F, 0xBA, 0xF8, 0x3F}, 5); // btc rax, 63
+                jit_store_rax(jit, top);
+                break;
+            }
+            
+            case OP_EQUAL_S64: case OP_NOT_EQUAL_S64: case OP_LESS_S64:
+            case OP_LESS_EQUAL_S64: case OP_GREATER_S64: case OP_GREATER_EQUAL_S64: {
+                u8 setcc = 0;
+                switch (instruction->op) {
+                    case OP_EQUAL_S64:         setcc = 0x94; break; // sete
+                    case OP_NOT_EQUAL_S64:     setcc = 0x95; break; // setne
+                    case OP_LESS_S64:          setcc = 0x9C; break; // setl
+                    case OP_LESS_EQUAL_S64:    setcc = 0x9E; break; // setle
+                    case OP_GREATER_S64:       setcc = 0x9F; break; // setg
+                    case OP_GREATER_EQUAL_S64: setcc = 0x9D; break; // setge
+                }
+                
+                jit_load_rax(jit, below);
+                JitFrameOperand(jit, RAX, top, 0x48, 0x3B); // cmp rax, [top]
+                jit_bytes(jit, (const u8[]){0x0F, setcc, 0xC0}, 3);
+                jit_bytes(jit, (const u8[]){0x0F, 0xB6, 0xC0}, 3); // movzx eax, al
+                jit_store_rax(jit, below);
+                break;
+            }
+            
+            case OP_EQUAL_F64: case OP_NOT_EQUAL_F64: case OP_LESS_F64:
+            case OP_LESS_EQUAL_F64: case OP_GREATER_F64: case OP_GREATER_EQUAL_F64: {
+                // A NaN makes ucomisd set ZF, PF and CF, and every
+                // comparison but != has to come out false for it.
+                switch (instruction->op) {
+                    case OP_EQUAL_F64: {
+                        jit_load_xmm0(jit, below);
+                        jit_ucomisd(jit, top);
+                        jit_bytes(jit, (const u8[]){
+                            0x0F, 0x94, 0xC0, // sete al
+                            0x0F, 0x9B, 0xC1, // setnp cl
+                            0x20, 0xC8,       // and al, cl
+                        }, 8);
+                        break;
+                    }
+                    case OP_NOT_EQUAL_F64: {
+                        jit_load_xmm0(jit, below);
+                        jit_ucomisd(jit, top);
+                        jit_bytes(jit, (const u8[]){
+                            0x0F, 0x95, 0xC0, // setne al
+                            0x0F, 0x9A, 0xC1, // setp cl
+                            0x08, 0xC8,       // or al, cl
+                        }, 8);
+                        break;
+                    }
+                    // a < b is b > a, which only needs CF and ZF.
+                    case OP_LESS_F64: case OP_LESS_EQUAL_F64: {
+                        jit_load_xmm0(jit, top);
+                        jit_ucomisd(jit, below);
+                        jit_bytes(jit, (const u8[]){0x0F, instruction->op == OP_LESS_F64 ? 0x97 : 0x93, 0xC0}, 3); // seta/setae
+                        break;
+                    }
+                    case OP_GREATER_F64: case OP_GREATER_EQUAL_F64: {
+                        jit_load_xmm0(jit, below);
+                        jit_ucomisd(jit, top);
+                        jit_bytes(jit, (const u8[]){0x0F, instruction->op == OP_GREATER_F64 ? 0x97 : 0x93, 0xC0}, 3);
+                        break;
+                    }
+                }
+                jit_bytes(jit, (const u8[]){0x0F, 0xB6, 0xC0}, 3); // movzx eax, al
+                jit_store_rax(jit, below);
+                break;
+            }
+            
+            case OP_JUMP: {
+                jit_byte(jit, 0xE9); // jmp rel32
+                patches[patch_count++] = (struct Jit_Patch){ jit->buffer_length, i + 1 + instruction->operand };
+                jit_u32(jit, 0);
+                break;
+            }
+            case OP_JUMP_IF_ZERO: {
+                jit_load_rax(jit, top);
+                jit_bytes(jit, (const u8[]){0x48, 0x85, 0xC0, 0x0F, 0x84}, 5); // test rax, rax; jz rel32
+                patches[patch_count++] = (struct Jit_Patch){ jit->buffer_length, i + 1 + instruction->operand };
+                jit_u32(jit, 0);
+                break;
+            }
+            
+            case OP_CALL: {
+                struct Function *callee = &program->functions[instruction->operand];
+                jit_mov_esi(jit, (u32)instruction->operand);
+                jit_lea_rdx(jit, top + 1 - callee->parameter_count);
+                jit_call_helper(jit, (void*)jit_call);
+                
+                depth += (callee->return_type ? 1 : 0) - callee->parameter_count;
+                break;
+            }
+            
+            case OP_PRINT_U8: case OP_PRINT_S64: case OP_PRINT_F64: case OP_PRINT_STRING: {
+                enum Type type = TYPE_NONE;
+                switch (instruction->op) {
+                    case OP_PRINT_U8:     type = TYPE_U8; break;
+                    case OP_PRINT_S64:    type = TYPE_S64; break;
+                    case OP_PRINT_F64:    type = TYPE_F64; break;
+                    case OP_PRINT_STRING: type = TYPE_STRING; break;
+                }
+                jit_mov_esi(jit, (u32)type);
+                jit_lea_rdx(jit, top);
+                jit_call_helper(jit, (void*)jit_print);
+                break;
+            }
+            
+            case OP_RETURN: {
+                jit_epilogue(jit);
+                break;
+            }
+            case OP_RETURN_VALUE: {
+                jit_load_rax(jit, top);
+                jit_store_rax(jit, 0);
+                jit_epilogue(jit);
+                break;
+            }
+            
+            default: {
+                // The VM reports it, when it gets there.
+                free(offsets);
+                free(patches);
+                return false;
+            }
+        }
+        
+        depth += stack_effect(instruction->op);
+        Assert(depth >= 0);
+    }
+    offsets[bytecode->count] = jit->buffer_length;
+    
+    // Every division by zero in the function jumps here.
+    u64 division_error = jit->buffer_length;
+    jit_call_helper(jit, (void*)vm_division_by_zero);
+    
+    for (int i = 0; i < patch_count; i++) {
+        u64 target = patches[i].target < 0 ? division_error : offsets[patches[i].target];
+        u32 rel32 = (u32)(s32)((s64)target - (s64)(patches[i].at + 4));
+        memcpy(jit->buffer + patches[i].at, &rel32, 4);
+    }
+    
+    free(offsets);
+    free(patches);
+    
+    // Copy it over, only making the pages it's on writable while we do.
+    if (!jit->code) {
+        jit->code = platform_alloc_code(JIT_CODE_SIZE);
+        if (!jit->code) {
+            jit->enabled = false;
+            return false;
+        }
+    }
+    
+    u64 start = (jit->code_used + 15) & ~(u64)15;
+    u64 end = start + jit->buffer_length;
+    if (end > JIT_CODE_SIZE) {
+        return false;
+    }
+    
+    u64 first_page = start & ~(u64)(JIT_PAGE_SIZE-1);
+    u64 last_page = (end + JIT_PAGE_SIZE-1) & ~(u64)(JIT_PAGE_SIZE-1);
+    
+    if (!platform_protect_code(jit->code + first_page, last_page - first_page, false)) {
+        return false;
+    }
+    memcpy(jit->code + start, jit->buffer, jit->buffer_length);
+    if (!platform_protect_code(jit->code + first_page, last_page - first_page, true)) {
+        program_error(program, "Couldn't make the generated code executable!\n");
+    }
+    
+    jit->code_used = end;
+    function->native = (Jit_Function*)(void*)(jit->code + start);
+    return true;
+}
+
+// Counts a call to the function, and compiles it once it's been called
+// JIT_CALL_THRESHOLD times. Returns its native code, or NULL if it has
+// to be interpreted.
+Jit_Function *
+jit_lookup(struct Program *program, struct Function *function) {
+    if (function->native || !program->jit.enabled || function->jit_failed) {
+        return function->native;
+    }
+    
+    if (++function->call_count >= JIT_CALL_THRESHOLD) {
+        function->jit_failed = !jit_compile(program, function);
+    }
+    return function->native;
+}
+
+void
+jit_free(struct Jit *jit) {
+    if (jit->code) {
+        platform_free_code(jit->code, JIT_CODE_SIZE);
+    }
+    free(jit->buffer);
+    *jit = (struct Jit){0};
+}
@@ -0,0 +1,40 @@
+// Functions that are called a lot get translated from bytecode into
+// x86-64 machine code, one instruction at a time. The machine code works
+// on the same stack frames as the VM, so each can call the other.
+//
+// Only the System V calling convention is generated, so there's no
+// JIT on Windows, or anywhere that isn't x86-64. Everything is just
+// interpreted there.
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_CALL_THRESHOLD 10 // Calls before a function is compiled. Compiling is cheap.
+#define JIT_CODE_SIZE Megabytes(64)
+#define JIT_PAGE_SIZE 4096
+
+// Native code calls back into C for calls and print(), so the two nest
+// on the C stack. Past this depth, everything is left to the VM, which
+// keeps its calls on program.call_stack instead.
+#define JIT_MAX_NATIVE_DEPTH 1024
+
+struct Program;
+
+// Runs the function with its frame at `frame`, leaving the
+// return value (if any) in frame[0].
+typedef void Jit_Function(union Value *frame, struct Program *program);
+
+struct Jit {
+    bool enabled; // False with --no-jit, or where there's no JIT.
+
+    // JIT_CODE_SIZE bytes, reserved the first time something's compiled.
+    u8 *code;
+    u64 code_used;
+
+    // Functions are generated in here, then copied into code.
+    u8 *buffer;
+    u64 buffer_length, buffer_capacity;
+};
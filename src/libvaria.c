@@ -0,0 +1,142 @@
+// The functions in varia.h, on top of the same unity build as the
+// executable. Built by build_lib.sh.
+//
+// Errors longjmp back here instead of exiting, and their messages go
+// into the interpreter instead of to stderr, so a bad program only
+// fails its own varia_load() or varia_run(). So do Panic()s and failed
+// Asserts, like running out of memory, through fatal_handler, but then
+// the program's thrown away, since it might have been half way through
+// changing something.
+
+#define VARIA_NO_MAIN
+#include "main.c"
+#include "varia.h"
+
+struct Varia {
+    struct Interpreter interp;
+    struct Function *main_function; // NULL until a program is loaded.
+    char *source; // Our copy. The tokens point into it.
+
+    char error[ERROR_MESSAGE_SIZE];
+};
+
+struct Varia *
+varia_create(const struct Varia_Options *options) {
+    struct Varia *varia = calloc(1, sizeof(struct Varia));
+    if (!varia) return NULL;
+
+    if (options) {
+        varia->interp.options.write = options->write;
+        varia->interp.options.write_data = options->write_data;
+        varia->interp.options.no_jit = options->no_jit;
+        varia->interp.options.heap_size = options->heap_size;
+        varia->interp.options.huge_pages = options->huge_pages;
+    }
+    return varia;
+}
+
+// Frees the loaded program, if there is one, but keeps the options.
+void
+varia_unload(struct Varia *varia) {
+    struct Interpreter *interp = &varia->interp;
+
+    program_free(interp);
+    tokenizer_free(&interp->tokenizer);
+    free(varia->source);
+
+    struct Options options = interp->options;
+    *interp = (struct Interpreter){0};
+    interp->options = options;
+
+    varia->main_function = NULL;
+    varia->source = NULL;
+}
+
+bool
+varia_load(struct Varia *varia, const char *name, const char *source, size_t length) {
+    struct Interpreter *interp = &varia->interp;
+
+    varia_unload(varia);
+    varia->error[0] = 0;
+
+    varia->source = malloc(length ? length : 1);
+    if (!varia->source) {
+        snprintf(varia->error, sizeof(varia->error), "Couldn't allocate memory for %s!\n", name);
+        return false;
+    }
+    memcpy(varia->source, source, length);
+
+    jmp_buf on_error;
+    struct Fatal_Handler handler = { &on_error, varia->error };
+    struct Fatal_Handler *outer = fatal_handler;
+    if (setjmp(on_error)) {
+        fatal_handler = outer;
+        varia_unload(varia);
+        return false;
+    }
+    fatal_handler = &handler;
+
+    interp->tokenizer = tokenizer_new(name, varia->source, length);
+    interp->tokenizer.on_error = &on_error;
+    interp->tokenizer.error_message = varia->error;
+
+    tokenize_all(&interp->tokenizer, length);
+
+    struct Function *main_function = program_check(interp);
+    run_function_pass(interp, compile_function);
+    program_free_trees(interp);
+
+    interp->tokenizer.on_error = NULL;
+    fatal_handler = outer;
+    varia->main_function = main_function;
+    return true;
+}
+
+bool
+varia_run(struct Varia *varia) {
+    struct Program *program = &varia->interp.program;
+
+    if (!varia->main_function) {
+        snprintf(varia->error, sizeof(varia->error), "There's no program loaded to run!\n");
+        return false;
+    }
+    varia->error[0] = 0;
+
+    jmp_buf on_error;
+    struct Fatal_Handler handler = { &on_error, varia->error };
+    struct Fatal_Handler *outer = fatal_handler;
+    int error = setjmp(on_error);
+    if (error) {
+        fatal_handler = outer;
+        program->on_error = NULL;
+        program->error_message = NULL;
+        if (error == FATAL_ERROR) {
+            varia_unload(varia);
+        } else {
+            vm_reset(program);
+        }
+        return false;
+    }
+    fatal_handler = &handler;
+    program->on_error = &on_error;
+    program->error_message = varia->error;
+
+    program_run(program, varia->main_function);
+
+    program->on_error = NULL;
+    program->error_message = NULL;
+    fatal_handler = outer;
+    return true;
+}
+
+const char *
+varia_error(struct Varia *varia) {
+    return varia->error;
+}
+
+void
+varia_destroy(struct Varia *varia) {
+    if (!varia) return;
+    varia_unload(varia);
+    free(varia);
+}
@@ -1,30 +1,135 @@
-#include <windows.h>
-
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <math.h>
+#include <setjmp.h>
 
 #include "util.c"
 
+#include "platform.h"
+#ifdef _WIN32
+#include "platform_win32.c"
+#else
+#include "platform_linux.c"
+#endif
+
 #include "tokenize.h"
+#include "output.h"
+#include "bytecode.h"
+#include "jit.h"
+#include "parse.h"
 #include "interpret.h"
+#include "profile.h"
 
+#include "output.c"
+#include "scan.c"
 #include "tokenize.c"
+#include "cache.c"
+#include "bytecode.c"
+#include "profile.c"
+#include "vm.c"
+#include "jit.c"
+#include "resolve.c"
+#include "parse.c"
+#include "typecheck.c"
+#include "emit_c.c"
 #include "interpret.c"
+#include "repl.c"
+
+// bench.c includes this file for everything above, and has its own main().
+#ifndef VARIA_NO_MAIN
 
 int
 main(int argc, char **argv) {
-    if (argc == 1) {
-        // Error("Sorry! You must call the interpreter with the file name of your source code!\n");
-        // return 1;
-        argv[1] = "test.c";
+    // Error("Sorry! You must call the interpreter with the file name of your source code!\n");
+    // return 1;
+    char *file_name = NULL;
+    struct Options options = {0};
+    bool repl_mode = false;
+    bool use_cache = true;
+    
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        
+        if (strncmp(arg, "--flush=", 8) == 0) {
+            // --flush=exit, --flush=line, or --flush=<bytes>
+            char *policy = arg + 8;
+            if (strcmp(policy, "exit") == 0) {
+                options.flush_policy = FLUSH_ON_EXIT;
+            } else if (strcmp(policy, "line") == 0) {
+                options.flush_policy = FLUSH_ON_NEWLINE;
+            } else if (atoll(policy) > 0) {
+                options.flush_policy = FLUSH_EVERY_N_BYTES;
+                options.flush_bytes = (u64)atoll(policy);
+            } else {
+                Error("--flush takes exit, line or a number of bytes.\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--profile") == 0 || strncmp(arg, "--profile=", 10) == 0) {
+            // --profile, or --profile=<file> for where the folded stacks go.
+            options.profile = true;
+            options.profile_path = arg[9] == '=' ? arg + 10 : "varia.folded";
+        } else if (strcmp(arg, "--no-jit") == 0) {
+            options.no_jit = true;
+        } else if (strncmp(arg, "--heap=", 7) == 0) {
+            // --heap=<size>, like --heap=64M or --heap=4G.
+            options.heap_size = parse_size(arg + 7);
+            if (!options.heap_size) {
+                Error("--heap takes a size, like 64M or 4G.\n");
+                return 1;
+            }
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            // --threads=<n>, instead of one for each core.
+            int count = atoi(arg + 10);
+            if (count <= 0) {
+                Error("--threads takes a number of threads.\n");
+                return 1;
+            }
+            platform_set_core_count(count);
+        } else if (strcmp(arg, "--huge-pages") == 0) {
+            options.huge_pages = true;
+        } else if (strcmp(arg, "--no-cache") == 0) {
+            use_cache = false;
+        } else if (strcmp(arg, "--repl") == 0) {
+            repl_mode = true;
+        } else if (strcmp(arg, "--emit-c") == 0 || strncmp(arg, "--emit-c=", 9) == 0) {
+            // --emit-c prints the C, --emit-c=<file> writes it to the file.
+            options.emit_c = true;
+            options.emit_c_path = arg[8] == '=' ? arg + 9 : NULL;
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            Error("Unknown option %s\n", arg);
+            return 1;
+        } else {
+            file_name = arg;
+        }
+    }
+    
+    if (repl_mode) {
+        // Only load a file if we're given one.
+        repl(options, file_name);
+        return 0;
+    }
+    if (!file_name) {
+        file_name = "test.c";
     }
     
-    char *source_buffer = read_entire_file(argv[1]);
-    struct Tokenizer tokenizer = tokenize(argv[1], source_buffer);
-    interpret(tokenizer);
-    free(source_buffer);
+    struct Mapped_File source;
+    if (!platform_map_file(file_name, &source, false)) {
+        Error("Couldn't open %s!\n", file_name);
+        return 1;
+    }
+    
+    struct Tokenizer tokenizer = use_cache ? tokenize_cached(file_name, source.data, source.size)
+                                           : tokenize(file_name, source.data, source.size);
+    interpret(tokenizer, options, NULL);
+    tokenizer_free(&tokenizer);
+    platform_unmap_file(&source);
     
     return 0;
 }
+
+#endif
@@ -0,0 +1,191 @@
+void
+output_setup(struct Output *output, enum Flush_Policy policy, u64 flush_bytes,
+             Output_Write *write, void *write_data)
+{
+    if (policy == FLUSH_DEFAULT) {
+        policy = !write && platform_stdout_is_terminal() ? FLUSH_ON_NEWLINE : FLUSH_EVERY_N_BYTES;
+    }
+    if (!flush_bytes) {
+        flush_bytes = OUTPUT_DEFAULT_FLUSH_BYTES;
+    }
+    
+    output->policy = policy;
+    output->flush_bytes = flush_bytes;
+    output->length = 0;
+    output->capacity = flush_bytes;
+    output->buffer = malloc(output->capacity);
+    Assert(output->buffer);
+    output->write = write;
+    output->write_data = write_data;
+}
+
+void
+output_send(struct Output *output, const char *data, u64 size) {
+    if (output->write) {
+        output->write(output->write_data, data, size);
+    } else if (!platform_write_stdout(data, size)) {
+        Error("Couldn't write the output!\n");
+    }
+}
+
+void
+output_flush(struct Output *output) {
+    if (output->length) {
+        output_send(output, output->buffer, output->length);
+    }
+    output->length = 0;
+}
+
+void
+output_free(struct Output *output) {
+    output_flush(output);
+    free(output->buffer);
+    *output = (struct Output){0};
+}
+
+void
+output_write(struct Output *output, const char *data, u64 size) {
+    if (output->length + size > output->capacity) {
+        if (output->policy == FLUSH_ON_EXIT) {
+            while (output->length + size > output->capacity) {
+                output->capacity *= 2;
+            }
+            output->buffer = realloc(output->buffer, output->capacity);
+            Assert(output->buffer);
+        } else {
+            output_flush(output);
+            
+            // Too big to buffer, so don't bother copying it.
+            if (size > output->capacity) {
+                output_send(output, data, size);
+                return;
+            }
+        }
+    }
+    
+    memcpy(output->buffer + output->length, data, size);
+    output->length += size;
+    
+    switch (output->policy) {
+        case FLUSH_ON_NEWLINE: {
+            if (memchr(data, '\n', size)) {
+                output_flush(output);
+            }
+            break;
+        }
+        case FLUSH_EVERY_N_BYTES: {
+            if (output->length >= output->flush_bytes) {
+                output_flush(output);
+            }
+            break;
+        }
+    }
+}
+
+// Writes the digits of value backwards, ending right before end.
+// Returns the first digit.
+char *
+format_u64(char *end, u64 value) {
+    static const char digit_pairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+    
+    char *s = end;
+    
+    // Two digits per division.
+    while (value >= 100) {
+        const char *pair = &digit_pairs[(value % 100) * 2];
+        value /= 100;
+        *--s = pair[1];
+        *--s = pair[0];
+    }
+    
+    if (value >= 10) {
+        const char *pair = &digit_pairs[value * 2];
+        *--s = pair[1];
+        *--s = pair[0];
+    } else {
+        *--s = (char)('0' + value);
+    }
+    
+    return s;
+}
+
+void
+output_s64(struct Output *output, s64 value) {
+    char text[24];
+    char *end = text + sizeof(text);
+    
+    u64 magnitude = value < 0 ? 0 - (u64)value : (u64)value;
+    char *s = format_u64(end, magnitude);
+    if (value < 0) {
+        *--s = '-';
+    }
+    
+    output_write(output, s, end - s);
+}
+
+// Same output as printf("%f"), which is what print() always did.
+void
+output_f64(struct Output *output, f64 value) {
+    char text[64];
+    
+    bool negative = signbit(value); // -0.0 prints as -0.000000 too.
+    f64 magnitude = fabs(value);
+    
+    // The integer part and the fraction are both exact, and scaling the
+    // fraction is off by at most 2^-33. So unless it's that close to a
+    // tie, rounding it gives the digits printf would give.
+    if (magnitude < 9007199254740992.0) { // 2^53, also false for NaN.
+        u64 integer = (u64)magnitude;
+        f64 scaled = (magnitude - (f64)integer) * 1000000.0;
+        u64 fraction = (u64)scaled;
+        f64 remainder = scaled - (f64)fraction;
+        
+        if (remainder < 0.5 - 1e-9 || remainder > 0.5 + 1e-9) {
+            if (remainder > 0.5) {
+                fraction++;
+            }
+            if (fraction == 1000000) {
+                integer++;
+                fraction = 0;
+            }
+            
+            char *end = text + sizeof(text);
+            char *s = end;
+            
+            for (int i = 0; i < 6; i++) {
+                *--s = (char)('0' + fraction % 10);
+                fraction /= 10;
+            }
+            *--s = '.';
+            s = format_u64(s, integer);
+            if (negative) {
+                *--s = '-';
+            }
+            
+            output_write(output, s, end - s);
+            return;
+        }
+    }
+    
+    int length = snprintf(text, sizeof(text), "%f", value);
+    if (length >= (int)sizeof(text)) {
+        // Huge values have lots of digits.
+        char *big = malloc(length + 1);
+        Assert(big);
+        snprintf(big, length + 1, "%f", value);
+        output_write(output, big, length);
+        free(big);
+        return;
+    }
+    output_write(output, text, length);
+}
@@ -0,0 +1,26 @@
+// print() writes into a buffer, which goes out to stdout
+// in big pieces instead of one write per value.
+
+enum Flush_Policy {
+    FLUSH_DEFAULT,       // FLUSH_ON_NEWLINE on a terminal, FLUSH_EVERY_N_BYTES otherwise.
+    FLUSH_ON_EXIT,       // Keep everything until the program ends.
+    FLUSH_ON_NEWLINE,    // So interactive output shows up line by line.
+    FLUSH_EVERY_N_BYTES, // Whenever the buffer holds flush_bytes.
+};
+
+#define OUTPUT_DEFAULT_FLUSH_BYTES Kilobytes(64)
+
+// Somewhere else for the output to go, like a program that runs Varia
+// programs and wants to keep what they print. data is passed back.
+typedef void Output_Write(void *data, const char *text, u64 size);
+
+struct Output {
+    char *buffer;
+    u64 length, capacity;
+    
+    enum Flush_Policy policy;
+    u64 flush_bytes;
+    
+    Output_Write *write; // NULL for stdout.
+    void *write_data;
+};
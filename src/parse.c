@@ -0,0 +1,283 @@
+// A precedence climbing parser for the values on the right of an =,
+// after a return, in call arguments and in conditions. Constant subtrees are folded
+// while parsing, so "x := 60*60*24;" compiles to a single push.
+
+#define MAX_CALL_ARGUMENTS 256
+
+struct Expr *
+expr_new(struct Interpreter *interp, enum Expr_Kind kind, struct Token *token) {
+    struct Expr *expr = arena_alloc(&interp->expr_arena, sizeof(struct Expr));
+    *expr = (struct Expr){0};
+    expr->kind = (u8)kind;
+    expr->token = token;
+    return expr;
+}
+
+// 0 means it's not a binary operator, and ends the expression.
+int
+binary_precedence(enum Token_Type type) {
+    switch (type) {
+        case TOKEN_EQUAL_EQUAL: case TOKEN_NOT_EQUAL:
+        case TOKEN_LESS: case TOKEN_LESS_EQUAL:
+        case TOKEN_GREATER: case TOKEN_GREATER_EQUAL: {
+            return 1;
+        }
+        case TOKEN_ADD: case TOKEN_SUBTRACT: {
+            return 2;
+        }
+        case TOKEN_MULTIPLY: case TOKEN_DIVIDE: {
+            return 3;
+        }
+    }
+    return 0;
+}
+
+// Comparisons give an int, whatever they compare.
+bool
+is_comparison(enum Token_Type type) {
+    return binary_precedence(type) == 1;
+}
+
+// Replaces a negation or an operation on constants with the result.
+// Operands of different types are left alone, so the compiler can
+// report the mismatch.
+void
+fold_constants(struct Interpreter *interp, struct Expr *expr) {
+    if (expr->kind == EXPR_NEGATE) {
+        struct Expr *operand = expr->binary.left;
+        if (operand->kind != EXPR_CONSTANT) return;
+        
+        if (operand->type == TYPE_S64) {
+            expr->value.s64 = (s64)(0 - (u64)operand->value.s64);
+        } else if (operand->type == TYPE_F64) {
+            expr->value.f64 = -operand->value.f64;
+        } else {
+            return;
+        }
+        
+        expr->kind = EXPR_CONSTANT;
+        expr->type = operand->type;
+        return;
+    }
+    
+    Assert(expr->kind == EXPR_BINARY);
+    
+    struct Expr *left = expr->binary.left;
+    struct Expr *right = expr->binary.right;
+    
+    if (left->kind != EXPR_CONSTANT || right->kind != EXPR_CONSTANT) return;
+    if (left->type != right->type) return;
+    
+    union Value result = {0};
+    
+    if (left->type == TYPE_S64) {
+        // Wrap around on overflow like the machine would,
+        // instead of leaving it undefined.
+        u64 a = (u64)left->value.s64;
+        u64 b = (u64)right->value.s64;
+        
+        switch (expr->op) {
+            case TOKEN_ADD:      result.s64 = (s64)(a + b); break;
+            case TOKEN_SUBTRACT: result.s64 = (s64)(a - b); break;
+            case TOKEN_MULTIPLY: result.s64 = (s64)(a * b); break;
+            
+            case TOKEN_EQUAL_EQUAL:   result.s64 = left->value.s64 == right->value.s64; break;
+            case TOKEN_NOT_EQUAL:     result.s64 = left->value.s64 != right->value.s64; break;
+            case TOKEN_LESS:          result.s64 = left->value.s64 <  right->value.s64; break;
+            case TOKEN_LESS_EQUAL:    result.s64 = left->value.s64 <= right->value.s64; break;
+            case TOKEN_GREATER:       result.s64 = left->value.s64 >  right->value.s64; break;
+            case TOKEN_GREATER_EQUAL: result.s64 = left->value.s64 >= right->value.s64; break;
+            
+            case TOKEN_DIVIDE: {
+                if (right->value.s64 == 0) {
+                    CompileError(interp, expr->token, "Division by zero.");
+                }
+                if (right->value.s64 == -1) {
+                    result.s64 = (s64)(0 - a);
+                } else {
+                    result.s64 = left->value.s64 / right->value.s64;
+                }
+                break;
+            }
+        }
+    } else if (left->type == TYPE_F64) {
+        f64 a = left->value.f64;
+        f64 b = right->value.f64;
+        
+        switch (expr->op) {
+            case TOKEN_ADD:      result.f64 = a + b; break;
+            case TOKEN_SUBTRACT: result.f64 = a - b; break;
+            case TOKEN_MULTIPLY: result.f64 = a * b; break;
+            case TOKEN_DIVIDE:   result.f64 = a / b; break;
+            
+            case TOKEN_EQUAL_EQUAL:   result.s64 = a == b; break;
+            case TOKEN_NOT_EQUAL:     result.s64 = a != b; break;
+            case TOKEN_LESS:          result.s64 = a <  b; break;
+            case TOKEN_LESS_EQUAL:    result.s64 = a <= b; break;
+            case TOKEN_GREATER:       result.s64 = a >  b; break;
+            case TOKEN_GREATER_EQUAL: result.s64 = a >= b; break;
+        }
+    } else {
+        return;
+    }
+    
+    expr->kind = EXPR_CONSTANT;
+    expr->type = is_comparison(expr->op) ? TYPE_S64 : left->type;
+    expr->value = result;
+}
+
+struct Expr *parse_expression(struct Interpreter *interp, struct Token **tok, int min_precedence);
+
+// name(arg, arg, ...)
+struct Expr *
+parse_call(struct Interpreter *interp, struct Token **tok) {
+    struct Expr *expr = expr_new(interp, EXPR_CALL, *tok);
+    
+    struct Expr *args[MAX_CALL_ARGUMENTS];
+    int arg_count = 0;
+    
+    *tok += 2; // Pass the name and the (
+    
+    while ((*tok)->type != TOKEN_CLOSE_FUNCTION) {
+        if (arg_count == MAX_CALL_ARGUMENTS) {
+            CompileError(interp, *tok, "Too many arguments.");
+        }
+        args[arg_count++] = parse_expression(interp, tok, 0);
+        
+        if ((*tok)->type == TOKEN_COMMA) {
+            (*tok)++;
+        } else if ((*tok)->type != TOKEN_CLOSE_FUNCTION) {
+            CompileError(interp, *tok, "Expected a , or a ) after the argument.");
+        }
+    }
+    (*tok)++;
+    
+    expr->call.arg_count = arg_count;
+    expr->call.args = arena_alloc(&interp->expr_arena, arg_count * sizeof(struct Expr*));
+    memcpy(expr->call.args, args, arg_count * sizeof(struct Expr*));
+    
+    return expr;
+}
+
+// A literal, variable, call, negation or something in parentheses.
+struct Expr *
+parse_operand(struct Interpreter *interp, struct Token **tok) {
+    struct Token *token = *tok;
+    struct Expr *expr = NULL;
+    
+    switch (token->type) {
+        case TOKEN_LITERAL: {
+            // Already decoded by the tokenizer.
+            struct Constant *constant = &interp->tokenizer.constants[token->constant];
+            expr = expr_new(interp, EXPR_CONSTANT, token);
+            
+            switch (constant->type) {
+                case CONSTANT_INT: {
+                    expr->type = TYPE_S64;
+                    expr->value.s64 = constant->int_value;
+                    break;
+                }
+                case CONSTANT_FLOAT: {
+                    expr->type = TYPE_F64;
+                    expr->value.f64 = constant->float_value;
+                    break;
+                }
+                case CONSTANT_STRING: {
+                    expr->type = TYPE_STRING;
+                    expr->value = string_value(constant->string);
+                    break;
+                }
+            }
+            (*tok)++;
+            break;
+        }
+        
+        case TOKEN_IDENTIFIER: {
+            if (token->identifier_type == IDENTIFIER_FUNCTION_CALL) {
+                expr = parse_call(interp, tok);
+            } else {
+                Assert(token->slot >= 0); // Bound by resolve_function().
+                expr = expr_new(interp, EXPR_VARIABLE, token);
+                expr->slot = token->slot;
+                (*tok)++;
+            }
+            break;
+        }
+        
+        case TOKEN_SUBTRACT: {
+            (*tok)++;
+            expr = expr_new(interp, EXPR_NEGATE, token);
+            expr->binary.left = parse_operand(interp, tok);
+            fold_constants(interp, expr);
+            break;
+        }
+        
+        case TOKEN_OPEN_FUNCTION: {
+            (*tok)++;
+            expr = parse_expression(interp, tok, 0);
+            if ((*tok)->type != TOKEN_CLOSE_FUNCTION) {
+                CompileError(interp, *tok, "Expected a ) to close the (");
+            }
+            (*tok)++;
+            break;
+        }
+        
+        default: {
+            CompileError(interp, token, "Expected a literal, a variable or a function call.");
+        }
+    }
+    
+    return expr;
+}
+
+// Parses operators that bind tighter than min_precedence,
+// and leaves *tok at the first token after the expression.
+struct Expr *
+parse_expression(struct Interpreter *interp, struct Token **tok, int min_precedence) {
+    struct Expr *left = parse_operand(interp, tok);
+    
+    for (;;) {
+        struct Token *op = *tok;
+        int precedence = binary_precedence(op->type);
+        if (precedence <= min_precedence) break;
+        
+        (*tok)++;
+        
+        struct Expr *expr = expr_new(interp, EXPR_BINARY, op);
+        expr->op = op->type;
+        expr->binary.left = left;
+        // Only take tighter operators on the right, so equal
+        // ones associate to the left: a-b-c is (a-b)-c.
+        expr->binary.right = parse_expression(interp, tok, precedence);
+        
+        fold_constants(interp, expr);
+        left = expr;
+    }
+    
+    return left;
+}
+
+// The condition of an if or while, which has to be followed by its {
+struct Expr *
+parse_condition(struct Interpreter *interp, struct Token **tok) {
+    struct Expr *expr = parse_expression(interp, tok, 0);
+    
+    if ((*tok)->type != TOKEN_OPEN_SCOPE) {
+        CompileError(interp, *tok, "Expected a { after the condition.");
+    }
+    
+    return expr;
+}
+
+// The value of a statement, which has to end with the ;
+struct Expr *
+parse_statement_value(struct Interpreter *interp, struct Token **tok) {
+    struct Expr *expr = parse_expression(interp, tok, 0);
+    
+    // It's reported where the ; should be, not at whatever's next.
+    if ((*tok)->type != TOKEN_END_STATEMENT) {
+        CompileError(interp, *tok - 1, "Expected a ; after the expression.");
+    }
+    
+    return expr;
+}
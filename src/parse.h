@@ -0,0 +1,63 @@
+// Expressions are parsed into a small tree before they're compiled,
+// so they can nest, and so constant parts can be folded up front.
+
+enum Expr_Kind {
+    EXPR_NONE,
+    EXPR_CONSTANT, // A literal, or a subtree that was folded into one.
+    EXPR_VARIABLE,
+    EXPR_CALL,
+    EXPR_NEGATE,
+    EXPR_BINARY,
+};
+
+struct Expr {
+    u8 kind; // enum Expr_Kind
+    u8 op;   // enum Token_Type, for EXPR_BINARY.
+    u8 type; // enum Type of the value. Constants get it from the
+             // parser, everything else from the type checker.
+
+    // The literal, variable, function name or operator.
+    // Only used for error messages, and to find the callee.
+    struct Token *token;
+
+    union {
+        union Value value; // EXPR_CONSTANT
+        int slot;          // EXPR_VARIABLE
+
+        struct {
+            struct Expr *left, *right; // Only left for EXPR_NEGATE.
+        } binary;
+
+        struct {
+            struct Expr **args;
+            int arg_count;
+            struct Function *function; // Filled in by the type checker.
+        } call;
+    };
+};
+
+enum Statement_Kind {
+    STATEMENT_NONE,
+    STATEMENT_DECLARATION, // "name : type;", "name : type = value;" or "name := value;"
+    STATEMENT_ASSIGNMENT,  // "name = value;"
+    STATEMENT_EXPRESSION,  // "call(...);", the value is thrown away.
+    STATEMENT_RETURN,      // "return;" or "return value;"
+    STATEMENT_IF,          // "if value {...}", maybe with "else {...}" or "else if ..."
+    STATEMENT_WHILE,       // "while value {...}"
+};
+
+// The type checker turns each function body into a list of these,
+// so the compiler doesn't have to parse anything or check any types.
+struct Statement {
+    u8 kind; // enum Statement_Kind
+    int slot; // The variable that's declared or assigned to.
+    
+    struct Token *token; // First token of the statement.
+    struct Expr *value;  // NULL if there's no value. The condition of an if or while.
+    
+    // The blocks of an if or while. An "else if" is an else_body
+    // that's just the next if.
+    struct Statement *body, *else_body;
+    
+    struct Statement *next;
+};
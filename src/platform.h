@@ -0,0 +1,71 @@
+// Everything that talks to the OS goes through here.
+// Each platform_*.c implements all of these.
+
+struct Mapped_File {
+    char *data; // Read only, and not null terminated.
+    u64 size;
+    void *handle; // Whatever the platform needs to unmap it.
+};
+
+// Maps the whole file into memory. Returns false if it couldn't be opened.
+// A writable mapping is copy on write, so the file itself never changes.
+bool platform_map_file(const char *path, struct Mapped_File *file, bool writable);
+void platform_unmap_file(struct Mapped_File *file);
+
+// Renames the file at from to to, replacing what's there in one step,
+// so nothing ever sees to missing. Returns false if it couldn't.
+bool platform_replace_file(const char *from, const char *to);
+
+// Different for every process that's running, for naming files.
+u32 platform_process_id(void);
+
+// Returns zeroed, read/write memory, or NULL.
+void *platform_alloc_memory(u64 size);
+void platform_free_memory(void *memory, u64 size);
+
+// Reserves address space without committing any memory to it, so
+// touching it faults until it's committed. Returns NULL if it can't.
+// huge_pages asks for transparent huge pages where the OS has them.
+// Free it with platform_free_memory().
+void *platform_reserve_memory(u64 size, bool huge_pages);
+
+// Commits part of a reservation, zeroed and read/write. memory and
+// size have to be page aligned. Returns false if we're out of memory.
+bool platform_commit_memory(void *memory, u64 size);
+
+// Memory for generated machine code. It's never writable and executable
+// at the same time: it starts out writable, and platform_protect_code()
+// switches pages between the two.
+void *platform_alloc_code(u64 size);
+bool platform_protect_code(void *memory, u64 size, bool executable);
+void platform_free_code(void *memory, u64 size);
+
+// Writes all of it to stdout. Returns false if that failed.
+bool platform_write_stdout(const char *data, u64 size);
+bool platform_stdout_is_terminal(void);
+
+// A monotonic clock, for timing things.
+u64 platform_nanoseconds(void);
+
+// How many threads can actually run at once, unless it's been set with
+// platform_set_core_count(), which is how --threads works.
+int platform_core_count(void);
+void platform_set_core_count(int count);
+
+// Calls work(data, i, thread) for every i below count, on up to
+// thread_count threads, and returns once they've all finished. Each
+// thread takes the next i that's left, so the order they run in isn't
+// fixed. thread is which of them it's on, below thread_count, for
+// anything each one needs its own copy of.
+//
+// The calling thread is thread 0, and the others come from a pool that's
+// started the first time it's needed and kept for the rest of the process,
+// so this costs a wake up rather than starting threads. It can be called
+// from any number of threads at once.
+//
+// platform_thread_count(count) is the most threads worth using, one per
+// core. Passing 1 does it all on the calling thread.
+#define PLATFORM_MAX_THREADS 64
+typedef void Platform_Work(void *data, int index, int thread);
+int platform_thread_count(int count);
+void platform_parallel_for(int count, int thread_count, Platform_Work *work, void *data);
@@ -0,0 +1,346 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+bool
+platform_map_file(const char *path, struct Mapped_File *file, bool writable) {
+    *file = (struct Mapped_File){0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    file->size = (u64)st.st_size;
+
+    // mmap() doesn't do empty mappings, but there's nothing to read anyway.
+    if (file->size) {
+        int protection = writable ? PROT_READ|PROT_WRITE : PROT_READ;
+        void *data = mmap(NULL, file->size, protection, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        // The tokenizer reads it front to back exactly once.
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        madvise(data, file->size, MADV_WILLNEED);
+        file->data = data;
+    }
+
+    // The mapping keeps the file alive.
+    close(fd);
+    return true;
+}
+
+void
+platform_unmap_file(struct Mapped_File *file) {
+    if (file->data) {
+        munmap(file->data, file->size);
+    }
+    *file = (struct Mapped_File){0};
+}
+
+bool
+platform_replace_file(const char *from, const char *to) {
+    return rename(from, to) == 0;
+}
+
+u32
+platform_process_id(void) {
+    return (u32)getpid();
+}
+
+void *
+platform_alloc_memory(u64 size) {
+    // Anonymous pages are zero filled, and only
+    // backed by real memory once they're touched.
+    void *memory = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+    return memory;
+}
+
+void
+platform_free_memory(void *memory, u64 size) {
+    munmap(memory, size);
+}
+
+#define PLATFORM_HUGE_PAGE_SIZE Megabytes(2)
+
+void *
+platform_reserve_memory(u64 size, bool huge_pages) {
+    // Huge pages only get used for 2MB aligned ranges, so we take
+    // a bit more and give back what's before and after that.
+    u64 reserve_size = huge_pages ? size + PLATFORM_HUGE_PAGE_SIZE : size;
+
+    void *memory = mmap(NULL, reserve_size, PROT_NONE,
+                        MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (huge_pages) {
+        u8 *start = (u8*)memory;
+        u8 *aligned = (u8*)(((uintptr_t)start + PLATFORM_HUGE_PAGE_SIZE-1) & ~(uintptr_t)(PLATFORM_HUGE_PAGE_SIZE-1));
+        u8 *end = start + reserve_size;
+
+        if (aligned > start) {
+            munmap(start, aligned - start);
+        }
+        if (end > aligned + size) {
+            munmap(aligned + size, end - (aligned + size));
+        }
+        memory = aligned;
+
+#ifdef MADV_HUGEPAGE
+        // Only advice. It's fine if THP is off.
+        madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    return memory;
+}
+
+bool
+platform_commit_memory(void *memory, u64 size) {
+    return mprotect(memory, size, PROT_READ|PROT_WRITE) == 0;
+}
+
+void *
+platform_alloc_code(u64 size) {
+    void *memory = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+    return memory;
+}
+
+// memory and size have to be page aligned.
+bool
+platform_protect_code(void *memory, u64 size, bool executable) {
+    int protection = executable ? PROT_READ|PROT_EXEC : PROT_READ|PROT_WRITE;
+    return mprotect(memory, size, protection) == 0;
+}
+
+void
+platform_free_code(void *memory, u64 size) {
+    munmap(memory, size);
+}
+
+bool
+platform_write_stdout(const char *data, u64 size) {
+    while (size) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= (u64)written;
+    }
+    return true;
+}
+
+bool
+platform_stdout_is_terminal(void) {
+    return isatty(STDOUT_FILENO);
+}
+
+u64
+platform_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec*1000000000ull + (u64)now.tv_nsec;
+}
+
+// 0 until it's set, for however many cores there are.
+static int platform_core_count_set;
+
+int
+platform_core_count(void) {
+    if (platform_core_count_set) return platform_core_count_set;
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+void
+platform_set_core_count(int count) {
+    platform_core_count_set = count;
+}
+
+int
+platform_thread_count(int count) {
+    int thread_count = platform_core_count();
+    if (thread_count > PLATFORM_MAX_THREADS) thread_count = PLATFORM_MAX_THREADS;
+    if (thread_count > count) thread_count = count;
+    return thread_count > 0 ? thread_count : 1;
+}
+
+// One pool of threads for the whole process, started the first time
+// something runs in parallel, and then kept. Each platform_parallel_for()
+// is a job the pool's threads join, up to the thread count it asked for,
+// while the calling thread works on it too. Jobs from different threads
+// (like interpreters embedded with libvaria) share the pool, and a job
+// never waits for a seat, since its caller gets through it alone if the
+// pool's busy.
+//
+// If the caller has a fatal_handler, a Panic() or failed Assert on any
+// thread stops the job, and goes to the caller's handler once everyone's
+// out of it.
+struct Parallel_For {
+    Platform_Work *work;
+    void *data;
+    int count;
+    int next; // The next index anyone takes.
+
+    bool catch_fatal;
+    int failed;
+    char fatal_message[ERROR_MESSAGE_SIZE]; // From the first thread that failed.
+
+    // The rest is only touched with the pool's lock held.
+    int thread_count;
+    int seated;  // Threads that have joined, counting the caller.
+    int running; // Pool threads that haven't finished with it yet.
+    pthread_cond_t finished;
+    struct Parallel_For *next_job;
+};
+
+struct Thread_Pool {
+    pthread_once_t once;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    struct Parallel_For *jobs; // The ones that still have seats left.
+};
+
+static struct Thread_Pool thread_pool = {
+    PTHREAD_ONCE_INIT, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL
+};
+
+void
+parallel_for_run(struct Parallel_For *job, int thread) {
+    struct Fatal_Handler *outer = fatal_handler;
+    jmp_buf on_error;
+    char message[ERROR_MESSAGE_SIZE];
+    struct Fatal_Handler handler = { &on_error, message };
+
+    if (job->catch_fatal) {
+        if (setjmp(on_error)) {
+            fatal_handler = outer;
+            if (!__atomic_exchange_n(&job->failed, 1, __ATOMIC_ACQ_REL)) {
+                memcpy(job->fatal_message, message, ERROR_MESSAGE_SIZE);
+            }
+            // Nobody needs to start anything else.
+            __atomic_store_n(&job->next, job->count, __ATOMIC_RELAXED);
+            return;
+        }
+        fatal_handler = &handler;
+    }
+
+    for (;;) {
+        int index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (index >= job->count) break;
+        job->work(job->data, index, thread);
+    }
+    fatal_handler = outer;
+}
+
+// Takes jobs off the pool's list until the process exits.
+void *
+thread_pool_thread(void *parameter) {
+    struct Thread_Pool *pool = parameter;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->jobs) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+
+        struct Parallel_For *job = pool->jobs;
+        int thread = job->seated++;
+        if (job->seated == job->thread_count) {
+            pool->jobs = job->next_job;
+        }
+        job->running++;
+
+        pthread_mutex_unlock(&pool->lock);
+        parallel_for_run(job, thread);
+        pthread_mutex_lock(&pool->lock);
+
+        if (--job->running == 0) {
+            pthread_cond_signal(&job->finished);
+        }
+    }
+    return NULL;
+}
+
+// One thread less than there are cores, since callers work too.
+void
+thread_pool_start(void) {
+    int count = platform_thread_count(PLATFORM_MAX_THREADS) - 1;
+    for (int i = 0; i < count; i++) {
+        pthread_t handle;
+        if (pthread_create(&handle, NULL, thread_pool_thread, &thread_pool) != 0) break;
+        pthread_detach(handle);
+    }
+}
+
+void
+platform_parallel_for(int count, int thread_count, Platform_Work *work, void *data) {
+    Assert(thread_count >= 1 && thread_count <= PLATFORM_MAX_THREADS);
+
+    struct Parallel_For job = { .work = work, .data = data, .count = count };
+    if (thread_count == 1) {
+        parallel_for_run(&job, 0);
+        return;
+    }
+
+    struct Thread_Pool *pool = &thread_pool;
+    pthread_once(&pool->once, thread_pool_start);
+
+    job.thread_count = thread_count;
+    job.seated = 1;
+    job.catch_fatal = fatal_handler != NULL;
+    pthread_cond_init(&job.finished, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    job.next_job = pool->jobs;
+    pool->jobs = &job;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    parallel_for_run(&job, 0);
+
+    // Nothing's left to take, so stop anyone else from joining,
+    // and wait for the ones that did.
+    pthread_mutex_lock(&pool->lock);
+    for (struct Parallel_For **at = &pool->jobs; *at; at = &(*at)->next_job) {
+        if (*at == &job) {
+            *at = job.next_job;
+            break;
+        }
+    }
+    while (job.running) {
+        pthread_cond_wait(&job.finished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_cond_destroy(&job.finished);
+
+    if (job.failed) {
+        fatal_error("%s", job.fatal_message);
+    }
+}
@@ -0,0 +1,326 @@
+#include <windows.h>
+
+bool
+platform_map_file(const char *path, struct Mapped_File *file, bool writable) {
+    *file = (struct Mapped_File){0};
+
+    HANDLE hFile = CreateFile(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL
+    );
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size)) {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    file->size = (u64)size.QuadPart;
+
+    // Empty files can't be mapped, but there's nothing to read anyway.
+    if (file->size) {
+        HANDLE hMapping = CreateFileMapping(hFile, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+        if (!hMapping) {
+            CloseHandle(hFile);
+            return false;
+        }
+
+        file->data = MapViewOfFile(hMapping, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+        if (!file->data) {
+            CloseHandle(hMapping);
+            CloseHandle(hFile);
+            return false;
+        }
+
+        file->handle = hMapping;
+    }
+
+    // The mapping keeps the file alive.
+    CloseHandle(hFile);
+    return true;
+}
+
+void
+platform_unmap_file(struct Mapped_File *file) {
+    if (file->data) {
+        UnmapViewOfFile(file->data);
+        CloseHandle((HANDLE)file->handle);
+    }
+    *file = (struct Mapped_File){0};
+}
+
+// This fails while another process has the file mapped.
+bool
+platform_replace_file(const char *from, const char *to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+u32
+platform_process_id(void) {
+    return (u32)GetCurrentProcessId();
+}
+
+void *
+platform_alloc_memory(u64 size) {
+    LPVOID base_address = (LPVOID) 0;
+    void *memory = VirtualAlloc(base_address,
+                                size,
+                                MEM_COMMIT|MEM_RESERVE,
+                                PAGE_READWRITE);
+    if (!memory) {
+        Error("VirtualAlloc() error! Win32 Error Code: %lu\n", GetLastError());
+    }
+    return memory;
+}
+
+void
+platform_free_memory(void *memory, u64 size) {
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+// Windows only has large pages that are locked in memory, need a
+// privilege, and have to be committed all at once, so huge_pages
+// is ignored.
+void *
+platform_reserve_memory(u64 size, bool huge_pages) {
+    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool
+platform_commit_memory(void *memory, u64 size) {
+    return VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+
+void *
+platform_alloc_code(u64 size) {
+    return VirtualAlloc(NULL, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+}
+
+// memory and size have to be page aligned.
+bool
+platform_protect_code(void *memory, u64 size, bool executable) {
+    DWORD old_protection;
+    if (!VirtualProtect(memory, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old_protection)) {
+        return false;
+    }
+    if (executable) {
+        FlushInstructionCache(GetCurrentProcess(), memory, size);
+    }
+    return true;
+}
+
+void
+platform_free_code(void *memory, u64 size) {
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+bool
+platform_write_stdout(const char *data, u64 size) {
+    HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    while (size) {
+        DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+        DWORD written;
+        if (!WriteFile(handle, data, chunk, &written, NULL)) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool
+platform_stdout_is_terminal(void) {
+    DWORD mode;
+    return GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &mode) != 0;
+}
+
+u64
+platform_nanoseconds(void) {
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+
+    // Split it up so it doesn't overflow.
+    u64 seconds = now.QuadPart / frequency.QuadPart;
+    u64 rest = now.QuadPart % frequency.QuadPart;
+    return seconds*1000000000ull + rest*1000000000ull/frequency.QuadPart;
+}
+
+// 0 until it's set, for however many cores there are.
+static int platform_core_count_set;
+
+int
+platform_core_count(void) {
+    if (platform_core_count_set) return platform_core_count_set;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void
+platform_set_core_count(int count) {
+    platform_core_count_set = count;
+}
+
+int
+platform_thread_count(int count) {
+    int thread_count = platform_core_count();
+    if (thread_count > PLATFORM_MAX_THREADS) thread_count = PLATFORM_MAX_THREADS;
+    if (thread_count > count) thread_count = count;
+    return thread_count > 0 ? thread_count : 1;
+}
+
+// See platform_linux.c. It's the same, with SRW locks and
+// condition variables instead of pthreads.
+struct Parallel_For {
+    Platform_Work *work;
+    void *data;
+    int count;
+    volatile LONG next; // The next index anyone takes, plus one.
+
+    bool catch_fatal;
+    volatile LONG failed;
+    char fatal_message[ERROR_MESSAGE_SIZE]; // From the first thread that failed.
+
+    // The rest is only touched with the pool's lock held.
+    int thread_count;
+    int seated;  // Threads that have joined, counting the caller.
+    int running; // Pool threads that haven't finished with it yet.
+    CONDITION_VARIABLE finished;
+    struct Parallel_For *next_job;
+};
+
+struct Thread_Pool {
+    INIT_ONCE once;
+    SRWLOCK lock;
+    CONDITION_VARIABLE work_ready;
+    struct Parallel_For *jobs; // The ones that still have seats left.
+};
+
+static struct Thread_Pool thread_pool = {
+    INIT_ONCE_STATIC_INIT, SRWLOCK_INIT, CONDITION_VARIABLE_INIT, NULL
+};
+
+void
+parallel_for_run(struct Parallel_For *job, int thread) {
+    struct Fatal_Handler *outer = fatal_handler;
+    jmp_buf on_error;
+    char message[ERROR_MESSAGE_SIZE];
+    struct Fatal_Handler handler = { &on_error, message };
+
+    if (job->catch_fatal) {
+        if (setjmp(on_error)) {
+            fatal_handler = outer;
+            if (!InterlockedExchange(&job->failed, 1)) {
+                memcpy(job->fatal_message, message, ERROR_MESSAGE_SIZE);
+            }
+            // Nobody needs to start anything else.
+            InterlockedExchange(&job->next, job->count);
+            return;
+        }
+        fatal_handler = &handler;
+    }
+
+    for (;;) {
+        int index = (int)InterlockedIncrement(&job->next) - 1;
+        if (index >= job->count) break;
+        job->work(job->data, index, thread);
+    }
+    fatal_handler = outer;
+}
+
+// Takes jobs off the pool's list until the process exits.
+DWORD WINAPI
+thread_pool_thread(LPVOID parameter) {
+    struct Thread_Pool *pool = parameter;
+
+    AcquireSRWLockExclusive(&pool->lock);
+    for (;;) {
+        while (!pool->jobs) {
+            SleepConditionVariableSRW(&pool->work_ready, &pool->lock, INFINITE, 0);
+        }
+
+        struct Parallel_For *job = pool->jobs;
+        int thread = job->seated++;
+        if (job->seated == job->thread_count) {
+            pool->jobs = job->next_job;
+        }
+        job->running++;
+
+        ReleaseSRWLockExclusive(&pool->lock);
+        parallel_for_run(job, thread);
+        AcquireSRWLockExclusive(&pool->lock);
+
+        if (--job->running == 0) {
+            WakeConditionVariable(&job->finished);
+        }
+    }
+    return 0;
+}
+
+// One thread less than there are cores, since callers work too.
+BOOL CALLBACK
+thread_pool_start(PINIT_ONCE once, PVOID parameter, PVOID *context) {
+    int count = platform_thread_count(PLATFORM_MAX_THREADS) - 1;
+    for (int i = 0; i < count; i++) {
+        HANDLE handle = CreateThread(NULL, 0, thread_pool_thread, &thread_pool, 0, NULL);
+        if (!handle) break;
+        CloseHandle(handle);
+    }
+    return TRUE;
+}
+
+void
+platform_parallel_for(int count, int thread_count, Platform_Work *work, void *data) {
+    Assert(thread_count >= 1 && thread_count <= PLATFORM_MAX_THREADS);
+
+    struct Parallel_For job = { .work = work, .data = data, .count = count };
+    if (thread_count == 1) {
+        parallel_for_run(&job, 0);
+        return;
+    }
+
+    struct Thread_Pool *pool = &thread_pool;
+    InitOnceExecuteOnce(&pool->once, thread_pool_start, NULL, NULL);
+
+    job.thread_count = thread_count;
+    job.seated = 1;
+    job.catch_fatal = fatal_handler != NULL;
+    InitializeConditionVariable(&job.finished);
+
+    AcquireSRWLockExclusive(&pool->lock);
+    job.next_job = pool->jobs;
+    pool->jobs = &job;
+    WakeAllConditionVariable(&pool->work_ready);
+    ReleaseSRWLockExclusive(&pool->lock);
+
+    parallel_for_run(&job, 0);
+
+    // Nothing's left to take, so stop anyone else from joining,
+    // and wait for the ones that did.
+    AcquireSRWLockExclusive(&pool->lock);
+    for (struct Parallel_For **at = &pool->jobs; *at; at = &(*at)->next_job) {
+        if (*at == &job) {
+            *at = job.next_job;
+            break;
+        }
+    }
+    while (job.running) {
+        SleepConditionVariableSRW(&job.finished, &pool->lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&pool->lock);
+
+    if (job.failed) {
+        fatal_error("%s", job.fatal_message);
+    }
+}
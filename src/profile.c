@@ -0,0 +1,253 @@
+struct Profiler *
+profiler_new(int print_function) {
+    struct Profiler *profiler = calloc(1, sizeof(struct Profiler));
+    Assert(profiler);
+    
+    profiler->print_function = print_function;
+    
+    // Every call on the call stack, plus main() and a print() on top.
+    profiler->frames = malloc((MAX_CALL_DEPTH + 2) * sizeof(struct Profile_Frame));
+    Assert(profiler->frames);
+    
+    profiler->node_capacity = 256;
+    profiler->nodes = malloc(profiler->node_capacity * sizeof(struct Profile_Node));
+    Assert(profiler->nodes);
+    
+    profiler->nodes[0] = (struct Profile_Node){
+        .function = -1,
+        .parent = -1,
+        .first_child = -1,
+        .next_sibling = -1,
+    };
+    profiler->node_count = 1;
+    
+    return profiler;
+}
+
+void
+profiler_free(struct Profiler *profiler) {
+    free(profiler->nodes);
+    free(profiler->frames);
+    free(profiler->functions);
+    free(profiler);
+}
+
+// Finds the node for calling `function` from `parent`, or makes one.
+int
+profile_child(struct Profiler *profiler, int parent, int function) {
+    int previous = -1;
+    
+    for (int child = profiler->nodes[parent].first_child;
+         child != -1;
+         child = profiler->nodes[child].next_sibling)
+    {
+        if (profiler->nodes[child].function == function) {
+            // Move it to the front, since the same call is usually made again soon.
+            if (previous != -1) {
+                profiler->nodes[previous].next_sibling = profiler->nodes[child].next_sibling;
+                profiler->nodes[child].next_sibling = profiler->nodes[parent].first_child;
+                profiler->nodes[parent].first_child = child;
+            }
+            return child;
+        }
+        previous = child;
+    }
+    
+    if (profiler->node_count == profiler->node_capacity) {
+        profiler->node_capacity *= 2;
+        profiler->nodes = realloc(profiler->nodes, profiler->node_capacity * sizeof(struct Profile_Node));
+        Assert(profiler->nodes);
+    }
+    
+    int child = profiler->node_count++;
+    profiler->nodes[child] = (struct Profile_Node){
+        .function = function,
+        .parent = parent,
+        .first_child = -1,
+        .next_sibling = profiler->nodes[parent].first_child,
+    };
+    profiler->nodes[parent].first_child = child;
+    
+    return child;
+}
+
+// Makes room for the stats of every function up to index.
+void
+profile_grow_functions(struct Profiler *profiler, int index) {
+    int old_capacity = profiler->function_capacity;
+    int capacity = old_capacity ? old_capacity : 64;
+    while (capacity <= index) capacity *= 2;
+    
+    profiler->functions = realloc(profiler->functions, capacity * sizeof(struct Profile_Function));
+    Assert(profiler->functions);
+    memset(profiler->functions + old_capacity, 0, (u64)(capacity - old_capacity) * sizeof(struct Profile_Function));
+    profiler->function_capacity = capacity;
+}
+
+void
+profile_enter(struct Profiler *profiler, int function) {
+    if (function >= profiler->function_capacity) {
+        profile_grow_functions(profiler, function);
+    }
+    
+    u64 now = platform_nanoseconds();
+    
+    int parent = profiler->frame_count ? profiler->frames[profiler->frame_count-1].node : 0;
+    int node = profile_child(profiler, parent, function);
+    profiler->nodes[node].calls++;
+    
+    struct Profile_Function *stats = &profiler->functions[function];
+    stats->calls++;
+    if (stats->active++ == 0) {
+        stats->outer_start_ns = now;
+    }
+    
+    profiler->frames[profiler->frame_count++] = (struct Profile_Frame){ node, now, 0 };
+}
+
+void
+profile_leave(struct Profiler *profiler) {
+    u64 now = platform_nanoseconds();
+    
+    Assert(profiler->frame_count > 0);
+    struct Profile_Frame *frame = &profiler->frames[--profiler->frame_count];
+    struct Profile_Node *node = &profiler->nodes[frame->node];
+    
+    u64 duration = now - frame->start_ns;
+    u64 exclusive = duration - frame->child_ns;
+    
+    node->exclusive_ns += exclusive;
+    
+    struct Profile_Function *stats = &profiler->functions[node->function];
+    stats->exclusive_ns += exclusive;
+    if (--stats->active == 0) {
+        stats->inclusive_ns += now - stats->outer_start_ns;
+    }
+    
+    if (profiler->frame_count) {
+        profiler->frames[profiler->frame_count-1].child_ns += duration;
+    }
+}
+
+struct Profile_Edge {
+    int caller, callee;
+    u64 calls;
+};
+
+int
+compare_edges(const void *a, const void *b) {
+    const struct Profile_Edge *x = a, *y = b;
+    if (x->caller != y->caller) return x->caller < y->caller ? -1 : 1;
+    if (x->callee != y->callee) return x->callee < y->callee ? -1 : 1;
+    return 0;
+}
+
+// Sorts function indices by inclusive time, most first.
+// qsort() has no context pointer, so the times come along.
+struct Profile_Row {
+    int function;
+    u64 inclusive_ns;
+};
+
+int
+compare_rows(const void *a, const void *b) {
+    const struct Profile_Row *x = a, *y = b;
+    if (x->inclusive_ns != y->inclusive_ns) return x->inclusive_ns > y->inclusive_ns ? -1 : 1;
+    return x->function - y->function;
+}
+
+// Writes "main;f;g <ns>" for every call path, which is what
+// flame graph tools take, and returns false if it couldn't.
+bool
+profile_write_folded(struct Profiler *profiler, struct Program *program, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    
+    int *stack = malloc(profiler->node_count * sizeof(int));
+    Assert(stack);
+    
+    for (int i = 1; i < profiler->node_count; i++) {
+        struct Profile_Node *node = &profiler->nodes[i];
+        if (!node->exclusive_ns) continue;
+        
+        int depth = 0;
+        for (int n = i; n != 0; n = profiler->nodes[n].parent) {
+            stack[depth++] = profiler->nodes[n].function;
+        }
+        
+        while (depth--) {
+            fprintf(file, "%s%c", program->functions[stack[depth]].name, depth ? ';' : ' ');
+        }
+        fprintf(file, "%llu\n", (unsigned long long)node->exclusive_ns);
+    }
+    
+    free(stack);
+    fclose(file);
+    return true;
+}
+
+// Prints a table of the functions and the calls between them to
+// stderr, since stdout has the program's output, and writes the
+// folded stacks to folded_path.
+void
+profile_report(struct Profiler *profiler, struct Program *program, const char *folded_path) {
+    struct Profile_Row *rows = malloc(program->function_count * sizeof(struct Profile_Row));
+    Assert(rows);
+    
+    int row_count = 0;
+    for (int i = 0; i < program->function_count && i < profiler->function_capacity; i++) {
+        if (!profiler->functions[i].calls) continue;
+        rows[row_count++] = (struct Profile_Row){ i, profiler->functions[i].inclusive_ns };
+    }
+    qsort(rows, row_count, sizeof(struct Profile_Row), compare_rows);
+    
+    Error("\n%-32s %12s %16s %16s\n", "Function", "Calls", "Inclusive ms", "Exclusive ms");
+    for (int i = 0; i < row_count; i++) {
+        struct Profile_Function *stats = &profiler->functions[rows[i].function];
+        Error("%-32s %12llu %16.3f %16.3f\n",
+              program->functions[rows[i].function].name,
+              (unsigned long long)stats->calls,
+              stats->inclusive_ns / 1e6,
+              stats->exclusive_ns / 1e6);
+    }
+    free(rows);
+    
+    // The same caller and callee can show up on lots of paths,
+    // so sort the edges to add those up.
+    struct Profile_Edge *edges = malloc(profiler->node_count * sizeof(struct Profile_Edge));
+    Assert(edges);
+    
+    int edge_count = 0;
+    for (int i = 1; i < profiler->node_count; i++) {
+        struct Profile_Node *node = &profiler->nodes[i];
+        if (node->parent == 0) continue; // main() isn't called by anything.
+        
+        edges[edge_count++] = (struct Profile_Edge){
+            profiler->nodes[node->parent].function,
+            node->function,
+            node->calls
+        };
+    }
+    qsort(edges, edge_count, sizeof(struct Profile_Edge), compare_edges);
+    
+    Error("\n%-32s %-32s %12s\n", "Caller", "Callee", "Calls");
+    for (int i = 0; i < edge_count; i++) {
+        u64 calls = edges[i].calls;
+        while (i+1 < edge_count && compare_edges(&edges[i], &edges[i+1]) == 0) {
+            calls += edges[++i].calls;
+        }
+        Error("%-32s %-32s %12llu\n",
+              program->functions[edges[i].caller].name,
+              program->functions[edges[i].callee].name,
+              (unsigned long long)calls);
+    }
+    free(edges);
+    
+    if (profile_write_folded(profiler, program, folded_path)) {
+        Error("\nWrote the folded stacks to %s\n", folded_path);
+    } else {
+        Error("\nCouldn't write the folded stacks to %s!\n", folded_path);
+    }
+}
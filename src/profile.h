@@ -0,0 +1,42 @@
+// The --profile flag. The VM tells the profiler about every call and
+// return, and it builds a tree of every call path it has seen, with how
+// many calls and how much time each one took. Everything in the report
+// is worked out from that tree at the end.
+
+struct Profile_Node {
+    int function; // Index into program.functions, -1 for the root.
+    int parent, first_child, next_sibling; // -1 if there isn't one.
+    
+    u64 calls;
+    u64 exclusive_ns; // Not counting the calls it made.
+};
+
+// One for each call that hasn't returned yet.
+struct Profile_Frame {
+    int node;
+    u64 start_ns;
+    u64 child_ns; // How long the calls it made took.
+};
+
+struct Profile_Function {
+    u64 calls;
+    u64 inclusive_ns, exclusive_ns;
+    
+    // Recursive calls are only counted once in inclusive_ns,
+    // from when the outermost one started.
+    int active;
+    u64 outer_start_ns;
+};
+
+struct Profiler {
+    struct Profile_Node *nodes; // nodes[0] is the root.
+    int node_count, node_capacity;
+    
+    struct Profile_Frame *frames;
+    int frame_count;
+    
+    // Indexed like program.functions, and grown to cover whatever's called.
+    struct Profile_Function *functions;
+    int function_capacity;
+    int print_function; // print() is counted like a call.
+};
@@ -0,0 +1,430 @@
+// --repl reads the program from stdin a piece at a time, and keeps one
+// interpreter around for the whole session. Each piece is tokenized on to
+// the end of the same token stream, and only its functions and statements
+// go through the resolver, type checker and compiler, so the time it
+// takes depends on what was typed, not on everything before it.
+//
+// Statements outside of any function go into one "repl" function that's
+// recompiled every time, and they're run straight away. Its top scope
+// and frame are kept, so variables declared there stay around.
+//
+// A function that's defined again replaces the old one in place, so
+// everything that calls it calls the new one. It can't change its
+// parameters or return type, since the callers were checked against them.
+
+#define REPL_SOURCE_SIZE Megabytes(64) // All the input of the session goes in here.
+
+// Statements outside of functions, from start up to end.
+struct Repl_Range {
+    struct Token *start, *end;
+};
+
+// A function that's being defined again. It's only swapped
+// in once the input it's in has compiled without errors.
+struct Repl_Redefinition {
+    int old_function; // Index into program.functions, since they can move.
+    struct Function *new_function;
+};
+
+struct Repl {
+    struct Interpreter interp;
+    struct Function *top_level; // Holds the statements outside of functions. It isn't in program.functions.
+    bool running; // Errors now are runtime errors, so nothing's undone.
+    
+    struct Repl_Range *ranges;
+    int range_count, range_capacity;
+    
+    struct Repl_Redefinition *redefinitions;
+    int redefinition_count, redefinition_capacity;
+    
+    // Where the tokens were when the functions' token pointers were set.
+    struct Token *tokens;
+    
+    // What to go back to if the input has a compile error.
+    int saved_function_count;
+    u32 *saved_function_table;
+    u32 saved_function_table_size;
+    int saved_var_count, saved_live_slot_count;
+};
+
+// Whether the input closes every { and " it opens. If it doesn't,
+// we keep reading lines before running anything.
+bool
+repl_input_is_complete(char *s, char *end) {
+    int depth = 0;
+    int lines = 0;
+    
+    while (s < end) {
+        if (*s == '"') {
+            s = find_quote(s+1, end, &lines);
+            if (s == end) return false;
+        } else if (s[0] == '/' && s+1 < end && s[1] == '/') {
+            s = find_line_end(s+2, end);
+            continue;
+        } else if (*s == '{') {
+            depth++;
+        } else if (*s == '}') {
+            depth--;
+        }
+        s++;
+    }
+    
+    return depth <= 0;
+}
+
+void
+repl_add_range(struct Repl *repl, struct Token *start, struct Token *end) {
+    if (start == end) return;
+    
+    if (repl->range_count == repl->range_capacity) {
+        repl->range_capacity = repl->range_capacity ? repl->range_capacity*2 : 16;
+        repl->ranges = realloc(repl->ranges, repl->range_capacity * sizeof(struct Repl_Range));
+        Assert(repl->ranges);
+    }
+    repl->ranges[repl->range_count++] = (struct Repl_Range){ start, end };
+}
+
+// Adds the function defined at tok, or gets ready to replace the
+// one that already has its name. Returns the new function.
+struct Function *
+repl_define_function(struct Repl *repl, struct Token *tok) {
+    struct Interpreter *interp = &repl->interp;
+    struct Function *old_function = program_find_function(&interp->program, tok->symbol);
+    
+    if (!old_function) {
+        return program_add_function(interp, tok);
+    }
+    
+    if (old_function->sys_function) {
+        CompileError1(interp, tok, "%s() is built in, so it can't be defined again.", old_function->name);
+    }
+    
+    if (repl->redefinition_count == repl->redefinition_capacity) {
+        repl->redefinition_capacity = repl->redefinition_capacity ? repl->redefinition_capacity*2 : 16;
+        repl->redefinitions = realloc(repl->redefinitions,
+                                      repl->redefinition_capacity * sizeof(struct Repl_Redefinition));
+        Assert(repl->redefinitions);
+    }
+    
+    struct Function *new_function = calloc(1, sizeof(struct Function));
+    Assert(new_function);
+    repl->redefinitions[repl->redefinition_count++] = (struct Repl_Redefinition){
+        (int)(old_function - interp->program.functions),
+        new_function
+    };
+    
+    function_setup(interp, new_function, tok);
+    
+    bool same_signature = new_function->parameter_count == old_function->parameter_count &&
+                          new_function->return_type == old_function->return_type;
+    for (int i = 0; same_signature && i < new_function->parameter_count; i++) {
+        same_signature = new_function->slot_types[i] == old_function->slot_types[i];
+    }
+    if (!same_signature) {
+        CompileError1(interp, tok, "%s() can't change its parameters or return type.", old_function->name);
+    }
+    
+    return new_function;
+}
+
+// Takes the variables the top scope got since the input started back out.
+// They're the newest ones, so no other variable's probe sequence goes past
+// them, and their table entries can just be cleared.
+void
+repl_forget_variables(struct Scope *scope, int var_count) {
+    u32 mask = scope->table_size-1;
+    
+    for (int i = var_count; i < scope->var_count; i++) {
+        u32 index = hash_symbol(scope->variables[i].symbol) & mask;
+        while (scope->variable_table[index] != (u32)i+1) {
+            index = (index+1) & mask;
+        }
+        scope->variable_table[index] = 0;
+    }
+    scope->var_count = var_count;
+}
+
+void
+repl_save(struct Repl *repl) {
+    struct Program *program = &repl->interp.program;
+    
+    repl->saved_function_count = program->function_count;
+    if (repl->saved_function_table_size != program->function_table_size) {
+        repl->saved_function_table_size = program->function_table_size;
+        repl->saved_function_table = realloc(repl->saved_function_table,
+                                             repl->saved_function_table_size * sizeof(u32));
+        Assert(repl->saved_function_table);
+    }
+    memcpy(repl->saved_function_table, program->function_table, repl->saved_function_table_size * sizeof(u32));
+    repl->saved_var_count = repl->top_level->top_scope->var_count;
+    repl->saved_live_slot_count = repl->top_level->live_slot_count;
+}
+
+// Undoes whatever the input with a compile error did.
+// Its source and tokens stay, but nothing refers to them.
+void
+repl_restore(struct Repl *repl) {
+    struct Program *program = &repl->interp.program;
+    
+    // One past the end might have been half set up when the error happened.
+    for (int i = repl->saved_function_count; i <= program->function_count && i < program->function_capacity; i++) {
+        function_free(&program->functions[i]);
+        program->functions[i] = (struct Function){0};
+    }
+    program->function_count = repl->saved_function_count;
+    
+    // The table might have grown since, but what was in it still fits.
+    if (program->function_table_size != repl->saved_function_table_size) {
+        program->function_table_size = repl->saved_function_table_size;
+        program->function_table = realloc(program->function_table, program->function_table_size * sizeof(u32));
+        Assert(program->function_table);
+    }
+    memcpy(program->function_table, repl->saved_function_table, program->function_table_size * sizeof(u32));
+    
+    for (int i = 0; i < repl->redefinition_count; i++) {
+        function_free(repl->redefinitions[i].new_function);
+        free(repl->redefinitions[i].new_function);
+    }
+    repl->redefinition_count = 0;
+    
+    struct Function *top_level = repl->top_level;
+    repl_forget_variables(top_level->top_scope, repl->saved_var_count);
+    top_level->current_scope = top_level->top_scope;
+    top_level->live_slot_count = repl->saved_live_slot_count;
+}
+
+// Functions point at their tokens, so they have to
+// follow them if adding tokens moved the array.
+void
+repl_rebase_tokens(struct Repl *repl) {
+    struct Program *program = &repl->interp.program;
+    struct Token *tokens = repl->interp.tokenizer.tokens;
+    if (tokens == repl->tokens) return;
+    
+    for (int i = 0; i < program->function_count; i++) {
+        struct Function *func = &program->functions[i];
+        if (func->token) {
+            func->token = tokens + (func->token - repl->tokens);
+            func->body = tokens + (func->body - repl->tokens);
+        }
+    }
+    repl->tokens = tokens;
+}
+
+// Compiles everything from token `first` on, which is all the input
+// since last time, and leaves the statements outside of functions
+// compiled in top_level. Returns false if there weren't any.
+bool
+repl_compile(struct Repl *repl, int first) {
+    struct Interpreter *interp = &repl->interp;
+    struct Program *program = &interp->program;
+    struct Tokenizer *tokenizer = &interp->tokenizer;
+    struct Function *top_level = repl->top_level;
+    
+    // Split the input into function definitions and everything else.
+    repl->range_count = 0;
+    
+    struct Token *end = tokenizer->tokens + tokenizer->token_count;
+    struct Token *range_start = tokenizer->tokens + first;
+    struct Token *tok = range_start;
+    
+    while (tok < end) {
+        if (tok->identifier_type == IDENTIFIER_FUNCTION_DEF) {
+            repl_add_range(repl, range_start, tok);
+            struct Function *func = repl_define_function(repl, tok);
+            tok = range_start = matching_brace(tokenizer, func->body) + 1;
+        } else if (tok->type == TOKEN_OPEN_SCOPE) {
+            tok = matching_brace(tokenizer, tok) + 1;
+        } else {
+            tok++;
+        }
+    }
+    repl_add_range(repl, range_start, end);
+    
+    // The same passes interpret() makes, on just the new parts.
+    for (int i = repl->saved_function_count; i < program->function_count; i++) {
+        resolve_function(interp, &program->functions[i]);
+    }
+    for (int i = 0; i < repl->redefinition_count; i++) {
+        resolve_function(interp, repl->redefinitions[i].new_function);
+    }
+    for (int i = 0; i < repl->range_count; i++) {
+        resolve_statements(interp, top_level, repl->ranges[i].start, repl->ranges[i].end);
+    }
+    
+    for (int i = repl->saved_function_count; i < program->function_count; i++) {
+        typecheck_function(interp, &program->functions[i]);
+    }
+    for (int i = 0; i < repl->redefinition_count; i++) {
+        typecheck_function(interp, repl->redefinitions[i].new_function);
+    }
+    
+    top_level->statements = NULL;
+    struct Statement **last = &top_level->statements;
+    for (int i = 0; i < repl->range_count; i++) {
+        typecheck_statements(interp, top_level, repl->ranges[i].start, repl->ranges[i].end, &last);
+    }
+    
+    // Nothing can go wrong from here on.
+    for (int i = repl->saved_function_count; i < program->function_count; i++) {
+        compile_function(interp, &program->functions[i]);
+    }
+    
+    for (int i = 0; i < repl->redefinition_count; i++) {
+        struct Repl_Redefinition *redefinition = &repl->redefinitions[i];
+        compile_function(interp, redefinition->new_function);
+        
+        // Any machine code the old one had is just left behind.
+        struct Function *old_function = &program->functions[redefinition->old_function];
+        function_free(old_function);
+        *old_function = *redefinition->new_function;
+        free(redefinition->new_function);
+    }
+    repl->redefinition_count = 0;
+    
+    top_level->bytecode.count = 0;
+    top_level->bytecode.depth = top_level->bytecode.max_depth = 0;
+    compile_function(interp, top_level);
+    
+    bool any_statements = top_level->statements != NULL;
+    program_free_trees(interp);
+    top_level->statements = NULL;
+    return any_statements;
+}
+
+// Tokenizes, compiles and runs the input from tokenizer.buffer_length
+// up to new_length. Returns false if there was an error, which has
+// been reported already.
+bool
+repl_eval(struct Repl *repl, u64 new_length) {
+    struct Interpreter *interp = &repl->interp;
+    struct Program *program = &interp->program;
+    
+    jmp_buf on_error;
+    if (setjmp(on_error)) {
+        interp->tokenizer.on_error = program->on_error = NULL;
+        program_free_trees(interp);
+        repl->top_level->statements = NULL;
+        repl_rebase_tokens(repl);
+        
+        if (repl->running) {
+            // The definitions are fine, it's just that running them failed.
+            vm_reset(program);
+            repl->running = false;
+        } else {
+            repl_restore(repl);
+        }
+        return false;
+    }
+    interp->tokenizer.on_error = program->on_error = &on_error;
+    
+    repl_save(repl);
+    
+    int first = tokenize_more(&interp->tokenizer, new_length);
+    repl_rebase_tokens(repl);
+    
+    if (repl_compile(repl, first)) {
+        repl->running = true;
+        vm_call(program, repl->top_level, program->stack);
+        output_flush(&program->output);
+        repl->running = false;
+    }
+    
+    interp->tokenizer.on_error = program->on_error = NULL;
+    return true;
+}
+
+// Runs the REPL until stdin runs out. If file_name isn't NULL,
+// that file is loaded first, as if it had been typed in.
+void
+repl(struct Options options, const char *file_name) {
+    struct Repl *repl = calloc(1, sizeof(struct Repl));
+    Assert(repl);
+    
+    // Symbols point into the source, so it's never moved. The pages
+    // are only backed by memory once something's written to them.
+    char *source = platform_alloc_memory(REPL_SOURCE_SIZE);
+    if (!source) {
+        Error("Couldn't allocate memory for the REPL!\n");
+        exit(1);
+    }
+    
+    // The profiler's calls wouldn't add up after an error.
+    options.profile = false;
+    
+    struct Interpreter *interp = &repl->interp;
+    interp->options = options;
+    interp->tokenizer = tokenizer_new("<repl>", source, 0);
+    repl->tokens = interp->tokenizer.tokens;
+    program_setup(interp);
+    
+    // It's not in program.functions, so it can't be called,
+    // and it doesn't move when functions are added.
+    struct Function *top_level = calloc(1, sizeof(struct Function));
+    Assert(top_level);
+    strcpy(top_level->name, "repl");
+    function_setup_scope(top_level);
+    top_level->jit_failed = true; // Its code changes every time.
+    repl->top_level = top_level;
+    
+    u64 length = 0;
+    
+    if (file_name) {
+        struct Mapped_File file;
+        if (!platform_map_file(file_name, &file, false)) {
+            Error("Couldn't open %s!\n", file_name);
+        } else if (file.size >= REPL_SOURCE_SIZE) {
+            Error("%s is too big for the REPL!\n", file_name);
+            platform_unmap_file(&file);
+        } else {
+            memcpy(source, file.data, file.size);
+            length = file.size;
+            platform_unmap_file(&file);
+            
+            // So the next input doesn't run on from the last line.
+            source[length++] = '\n';
+            repl_eval(repl, length);
+        }
+    }
+    
+    bool show_prompt = platform_stdout_is_terminal();
+    
+    for (;;) {
+        u64 start = length;
+        
+        // Keep reading until the input closes everything it opens.
+        do {
+            if (show_prompt) {
+                fputs(length == start ? "> " : ". ", stdout);
+                fflush(stdout);
+            }
+            
+            // Leave room for the newline we might add.
+            if (!fgets(source + length, (int)(REPL_SOURCE_SIZE - length - 1), stdin)) {
+                break;
+            }
+            length += strlen(source + length);
+        } while (!repl_input_is_complete(source + start, source + length));
+        
+        if (length == start) break;
+        
+        if (source[length-1] != '\n') {
+            source[length++] = '\n';
+        }
+        repl_eval(repl, length);
+    }
+    
+    if (show_prompt) {
+        fputs("\n", stdout);
+    }
+    
+    free(repl->ranges);
+    free(repl->redefinitions);
+    free(repl->saved_function_table);
+    function_free(repl->top_level);
+    free(repl->top_level);
+    program_free(interp);
+    tokenizer_free(&interp->tokenizer);
+    platform_free_memory(source, REPL_SOURCE_SIZE);
+    free(repl);
+}
@@ -0,0 +1,328 @@
+// The scoping is fully lexical, so before anything is compiled we
+// give every variable a fixed slot in its function's frame, and write
+// that slot into each token that refers to it. After this pass, names
+// are never looked up again.
+
+enum Type
+get_type(struct Token *token) {
+    enum Type result = 0;
+    
+    switch (token->symbol) {
+        case SYMBOL_CHAR: case SYMBOL_U8: {
+            result = TYPE_U8;
+            break;
+        }
+        case SYMBOL_INT: case SYMBOL_I64: {
+            result = TYPE_S64;
+            break;
+        }
+        case SYMBOL_FLOAT: case SYMBOL_F64: {
+            result = TYPE_F64;
+            break;
+        }
+        case SYMBOL_STRING: {
+            result = TYPE_STRING;
+            break;
+        }
+    }
+    
+    return result;
+}
+
+// Leaves *tok at the semicolon that ends the statement. If it's
+// missing, that's at the { or } after the statement instead, so the
+// next block isn't taken as part of it, and it's still matched up.
+void
+skip_to_end_of_statement(struct Token **tok) {
+    while ((*tok)->type != TOKEN_NONE &&
+           (*tok)->type != TOKEN_END_STATEMENT &&
+           (*tok)->type != TOKEN_OPEN_SCOPE &&
+           (*tok)->type != TOKEN_CLOSE_SCOPE)
+    {
+        (*tok)++;
+    }
+}
+
+// Leaves *tok at the { of an if or while, or at
+// the end of the statement if the { is missing.
+void
+skip_to_block(struct Token **tok) {
+    while ((*tok)->type != TOKEN_NONE &&
+           (*tok)->type != TOKEN_END_STATEMENT &&
+           (*tok)->type != TOKEN_OPEN_SCOPE)
+    {
+        (*tok)++;
+    }
+}
+
+void
+function_setup_scope(struct Function *function) {
+    function->top_scope = calloc(1, sizeof(struct Scope));
+    function->current_scope = function->top_scope;
+}
+
+// Called at a { inside a function body.
+void
+function_push_scope(struct Function *function) {
+    struct Scope *up = function->current_scope;
+    struct Scope *scope = up->down;
+    
+    if (scope) {
+        scope->var_count = 0;
+        if (scope->table_size) {
+            memset(scope->variable_table, 0, scope->table_size * sizeof(u32));
+        }
+    } else {
+        scope = calloc(1, sizeof(struct Scope));
+        Assert(scope);
+        up->down = scope;
+        scope->up = up;
+    }
+    
+    scope->first_slot = function->live_slot_count;
+    function->current_scope = scope;
+}
+
+// Called at the matching }. Its variables are out of
+// scope now, so the next block can have their slots.
+void
+function_pop_scope(struct Function *function) {
+    struct Scope *scope = function->current_scope;
+    Assert(scope->up);
+    
+    function->live_slot_count = scope->first_slot;
+    function->current_scope = scope->up;
+}
+
+void
+function_free_scopes(struct Function *function) {
+    struct Scope *scope = function->top_scope;
+    while (scope) {
+        struct Scope *down = scope->down;
+        free(scope->variables);
+        free(scope->variable_table);
+        free(scope);
+        scope = down;
+    }
+    function->top_scope = function->current_scope = NULL;
+}
+
+struct Variable *
+scope_find_variable(struct Scope *scope, u32 symbol) {
+    if (!scope->table_size) return NULL;
+    
+    u32 mask = scope->table_size-1;
+    
+    for (u32 index = hash_symbol(symbol) & mask;
+         scope->variable_table[index];
+         index = (index+1) & mask)
+    {
+        struct Variable *var = &scope->variables[scope->variable_table[index]-1];
+        if (var->symbol == symbol) {
+            return var;
+        }
+    }
+    
+    return NULL;
+}
+
+struct Variable *
+program_find_variable(struct Function *curr_func, u32 symbol) {
+    struct Scope *scope = curr_func->current_scope;
+    while (scope) {
+        struct Variable *var = scope_find_variable(scope, symbol);
+        if (var) {
+            return var;
+        }
+        scope = scope->up;
+    }
+    
+    return NULL;
+}
+
+// Adds a slot to the function's frame layout.
+// type can be TYPE_NONE if the compiler still has to infer it.
+int
+function_add_slot(struct Function *function, enum Type type) {
+    // Only grow the frame if no slot is free from an earlier block.
+    if (function->live_slot_count == function->slot_count) {
+        if (function->slot_count == function->slot_capacity) {
+            function->slot_capacity = function->slot_capacity ? function->slot_capacity*2 : 16;
+            function->slot_types = realloc(function->slot_types,
+                                           function->slot_capacity * sizeof(enum Type));
+            Assert(function->slot_types);
+        }
+        function->slot_count++;
+    }
+    
+    int slot = function->live_slot_count++;
+    function->slot_types[slot] = type;
+    return slot;
+}
+
+// Puts variables[index] in the scope's table.
+void
+scope_insert_variable(struct Scope *scope, int index) {
+    u32 mask = scope->table_size-1;
+    u32 entry = hash_symbol(scope->variables[index].symbol) & mask;
+    while (scope->variable_table[entry]) {
+        entry = (entry+1) & mask;
+    }
+    scope->variable_table[entry] = (u32)index+1;
+}
+
+// Doubles the room for variables, and rebuilds the table to match.
+// It's rebuilt in the order they were declared, so each variable's
+// probe sequence still only goes past older ones.
+void
+scope_grow(struct Scope *scope) {
+    scope->var_capacity = scope->var_capacity ? scope->var_capacity*2 : 8;
+    scope->variables = realloc(scope->variables, scope->var_capacity * sizeof(struct Variable));
+    Assert(scope->variables);
+    
+    free(scope->variable_table);
+    scope->table_size = (u32)scope->var_capacity*2;
+    scope->variable_table = calloc(scope->table_size, sizeof(u32));
+    Assert(scope->variable_table);
+    
+    for (int i = 0; i < scope->var_count; i++) {
+        scope_insert_variable(scope, i);
+    }
+}
+
+// The pointer is only good until the next variable is added to the scope.
+struct Variable *
+program_add_variable(struct Function *function,
+                     struct Scope *scope,
+                     u32 symbol,
+                     enum Type type,
+                     bool is_pointer)
+{
+    if (scope->var_count == scope->var_capacity) {
+        scope_grow(scope);
+    }
+    
+    int index = scope->var_count++;
+    struct Variable *var = &scope->variables[index];
+    var->symbol = symbol;
+    var->is_pointer = is_pointer;
+    var->slot = function_add_slot(function, type);
+    
+    scope_insert_variable(scope, index);
+    
+    return var;
+}
+
+
+// Binds every variable reference between start and end to its slot.
+void
+resolve_uses(struct Interpreter *interp, struct Function *func, struct Token *start, struct Token *end) {
+    for (struct Token *tok = start; tok < end; tok++) {
+        if (tok->type != TOKEN_IDENTIFIER) continue;
+        if (tok->identifier_type != IDENTIFIER_VARIABLE_OR_TYPE) continue;
+        
+        struct Variable *var = program_find_variable(func, tok->symbol);
+        if (!var) {
+            char name[MAX_TOKEN_LENGTH];
+            CompileError1(interp, tok, "%s is not defined",
+                          token_name(&interp->tokenizer, tok, name));
+        }
+        tok->slot = var->slot;
+    }
+}
+
+// "name : type = ...;", "name : *type = ...;" or "name := ...;"
+void
+resolve_declaration(struct Interpreter *interp, struct Function *func, struct Token *tok, struct Token *end) {
+    struct Token *tok_variable_name = tok;
+    
+    bool is_pointer = tok[2].type == TOKEN_POINTER;
+    enum Type type = 0;
+    struct Token *tok_equals;
+    
+    if (tok[2].type == TOKEN_EQUAL) {
+        tok_equals = tok + 2; // The type is inferred by the compiler.
+    } else {
+        struct Token *tok_type = is_pointer ? tok + 3 : tok + 2;
+        type = get_type(tok_type);
+        tok_equals = tok_type + 1;
+    }
+    
+    // Resolve the initializer first, so "a := a;" doesn't refer to itself.
+    if (tok_equals < end && tok_equals->type == TOKEN_EQUAL) {
+        resolve_uses(interp, func, tok_equals + 1, end);
+    }
+    
+    if (program_find_variable(func, tok_variable_name->symbol)) {
+        char name[MAX_TOKEN_LENGTH];
+        CompileError1(interp, tok_variable_name, "%s is already defined",
+                      token_name(&interp->tokenizer, tok_variable_name, name));
+    }
+    
+    struct Variable *var = program_add_variable(func,
+                                                func->current_scope,
+                                                tok_variable_name->symbol,
+                                                type,
+                                                is_pointer);
+    tok_variable_name->slot = var->slot;
+}
+
+// Goes through the statements from start up to end in order, and every { }
+// in there is a scope, whether it's the block of an if, a while or neither.
+void
+resolve_statements(struct Interpreter *interp, struct Function *func, struct Token *start, struct Token *end) {
+    for (struct Token *tok = start; tok < end; tok++) {
+        if (tok->type == TOKEN_OPEN_SCOPE) {
+            function_push_scope(func);
+        } else if (tok->type == TOKEN_CLOSE_SCOPE) {
+            function_pop_scope(func);
+        } else if (tok->type == TOKEN_IDENTIFIER) {
+            struct Token *statement_end = tok;
+            skip_to_end_of_statement(&statement_end);
+            
+            switch (tok->identifier_type) {
+                case IDENTIFIER_VARIABLE_OR_TYPE: {
+                    if (tok[1].type == TOKEN_COLON) {
+                        resolve_declaration(interp, func, tok, statement_end);
+                    } else if (tok[1].type == TOKEN_EQUAL) {
+                        resolve_uses(interp, func, tok, statement_end);
+                    }
+                    tok = statement_end;
+                    break;
+                }
+                
+                case IDENTIFIER_FUNCTION_CALL: {
+                    resolve_uses(interp, func, tok + 2, statement_end);
+                    tok = statement_end;
+                    break;
+                }
+                
+                case IDENTIFIER_KEYWORD: {
+                    if (tok->symbol == SYMBOL_RETURN) {
+                        resolve_uses(interp, func, tok + 1, statement_end);
+                        tok = statement_end;
+                    } else if (tok->symbol == SYMBOL_IF || tok->symbol == SYMBOL_WHILE) {
+                        // The condition, then carry on at the {
+                        struct Token *block = tok;
+                        skip_to_block(&block);
+                        resolve_uses(interp, func, tok + 1, block);
+                        tok = block - 1;
+                    }
+                    break;
+                }
+            }
+            
+            // A brace that cut the statement short still opens or closes a scope.
+            if (tok->type == TOKEN_OPEN_SCOPE || tok->type == TOKEN_CLOSE_SCOPE) {
+                tok--;
+            }
+        }
+        
+        if (tok->type == TOKEN_NONE) break;
+    }
+}
+
+void
+resolve_function(struct Interpreter *interp, struct Function *func) {
+    resolve_statements(interp, func, func->body + 1, matching_brace(&interp->tokenizer, func->body));
+}
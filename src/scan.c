@@ -0,0 +1,250 @@
+// Character classification and the scanning loops the tokenizer
+// spends nearly all of its time in. With SSE2 these look at 16 bytes
+// at a time. The scalar versions are the reference, and handle the
+// tails of the buffer that are too short for a whole vector.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+enum Char_Class {
+    CHAR_OTHER      = 0,
+    CHAR_WHITESPACE = 1 << 0,
+    CHAR_LETTER     = 1 << 1, // Or _
+    CHAR_DIGIT      = 1 << 2,
+    CHAR_DOT        = 1 << 3,
+    CHAR_SPECIAL    = 1 << 4,
+};
+
+static const u8 char_classes[256] = {
+    // Whitespace
+    ['\t'] = CHAR_WHITESPACE, ['\n'] = CHAR_WHITESPACE,
+    ['\r'] = CHAR_WHITESPACE, [' '] = CHAR_WHITESPACE,
+
+    // Identifiers
+    ['A'] = CHAR_LETTER, ['B'] = CHAR_LETTER, ['C'] = CHAR_LETTER,
+    ['D'] = CHAR_LETTER, ['E'] = CHAR_LETTER, ['F'] = CHAR_LETTER,
+    ['G'] = CHAR_LETTER, ['H'] = CHAR_LETTER, ['I'] = CHAR_LETTER,
+    ['J'] = CHAR_LETTER, ['K'] = CHAR_LETTER, ['L'] = CHAR_LETTER,
+    ['M'] = CHAR_LETTER, ['N'] = CHAR_LETTER, ['O'] = CHAR_LETTER,
+    ['P'] = CHAR_LETTER, ['Q'] = CHAR_LETTER, ['R'] = CHAR_LETTER,
+    ['S'] = CHAR_LETTER, ['T'] = CHAR_LETTER, ['U'] = CHAR_LETTER,
+    ['V'] = CHAR_LETTER, ['W'] = CHAR_LETTER, ['X'] = CHAR_LETTER,
+    ['Y'] = CHAR_LETTER, ['Z'] = CHAR_LETTER,
+    ['a'] = CHAR_LETTER, ['b'] = CHAR_LETTER, ['c'] = CHAR_LETTER,
+    ['d'] = CHAR_LETTER, ['e'] = CHAR_LETTER, ['f'] = CHAR_LETTER,
+    ['g'] = CHAR_LETTER, ['h'] = CHAR_LETTER, ['i'] = CHAR_LETTER,
+    ['j'] = CHAR_LETTER, ['k'] = CHAR_LETTER, ['l'] = CHAR_LETTER,
+    ['m'] = CHAR_LETTER, ['n'] = CHAR_LETTER, ['o'] = CHAR_LETTER,
+    ['p'] = CHAR_LETTER, ['q'] = CHAR_LETTER, ['r'] = CHAR_LETTER,
+    ['s'] = CHAR_LETTER, ['t'] = CHAR_LETTER, ['u'] = CHAR_LETTER,
+    ['v'] = CHAR_LETTER, ['w'] = CHAR_LETTER, ['x'] = CHAR_LETTER,
+    ['y'] = CHAR_LETTER, ['z'] = CHAR_LETTER,
+    ['_'] = CHAR_LETTER,
+
+    // Literals
+    ['0'] = CHAR_DIGIT, ['1'] = CHAR_DIGIT, ['2'] = CHAR_DIGIT,
+    ['3'] = CHAR_DIGIT, ['4'] = CHAR_DIGIT, ['5'] = CHAR_DIGIT,
+    ['6'] = CHAR_DIGIT, ['7'] = CHAR_DIGIT, ['8'] = CHAR_DIGIT,
+    ['9'] = CHAR_DIGIT,
+    ['.'] = CHAR_DOT,
+
+    // Special characters, see is_special_char()
+    [':'] = CHAR_SPECIAL, ['='] = CHAR_SPECIAL, ['+'] = CHAR_SPECIAL,
+    ['-'] = CHAR_SPECIAL, ['*'] = CHAR_SPECIAL, ['/'] = CHAR_SPECIAL,
+    ['&'] = CHAR_SPECIAL, [';'] = CHAR_SPECIAL, ['('] = CHAR_SPECIAL,
+    [')'] = CHAR_SPECIAL, ['{'] = CHAR_SPECIAL, ['}'] = CHAR_SPECIAL,
+    [','] = CHAR_SPECIAL, ['"'] = CHAR_SPECIAL, ['<'] = CHAR_SPECIAL,
+    ['>'] = CHAR_SPECIAL, ['!'] = CHAR_SPECIAL,
+};
+
+bool
+is_special_char(char c) {
+    return char_classes[(u8)c] & CHAR_SPECIAL;
+}
+
+bool
+is_valid_identifier_char(bool first, char c) {
+    if (first) {
+        return char_classes[(u8)c] & CHAR_LETTER;
+    }
+    return char_classes[(u8)c] & (CHAR_LETTER|CHAR_DIGIT);
+}
+
+bool
+is_literal_char(char c) {
+    return char_classes[(u8)c] & (CHAR_DIGIT|CHAR_DOT);
+}
+
+bool
+is_whitespace(char c) {
+    return char_classes[(u8)c] & CHAR_WHITESPACE;
+}
+
+// Counts the line breaks in s[0..length). "\r\n" is one line break,
+// and so is a lone '\r' or '\n'. next is the char after the range,
+// or 0 at the end of the buffer.
+int
+count_lines_scalar(const char *s, u64 length, char next) {
+    int lines = 0;
+    for (u64 i = 0; i < length; i++) {
+        if (s[i] == '\n') {
+            lines++;
+        } else if (s[i] == '\r') {
+            char after = (i+1 < length) ? s[i+1] : next;
+            if (after != '\n') lines++;
+        }
+    }
+    return lines;
+}
+
+#ifdef SCAN_SSE2
+
+// Returns the line breaks in the first `count` bytes of chunk,
+// where next is the byte after the whole 16 byte chunk.
+int
+count_lines_sse2(__m128i chunk, int count, char next) {
+    u32 lf = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+    u32 cr = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+    
+    // A '\r' followed by a '\n' is counted by the '\n'.
+    u32 followed_by_lf = (lf >> 1) | (next == '\n' ? 1u << 15 : 0);
+    u32 breaks = lf | (cr & ~followed_by_lf);
+    
+    u32 keep = count == 16 ? 0xFFFF : (1u << count) - 1;
+    return count_bits(breaks & keep);
+}
+
+// Mask of the bytes in chunk that are between lo and hi, inclusive.
+// Bytes >= 0x80 are negative here, so they never match.
+__m128i
+sse2_in_range(__m128i chunk, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(lo-1)),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8(hi+1)));
+}
+
+#endif
+
+// Returns the first char that isn't whitespace,
+// and adds the line breaks we skipped to *line.
+char *
+skip_whitespace(char *s, char *end, int *line) {
+#ifdef SCAN_SSE2
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)s);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                               _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                                               _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+        u32 mask = (u32)_mm_movemask_epi8(ws);
+        char next = (end - s > 16) ? s[16] : 0;
+        
+        if (mask != 0xFFFF) {
+            int count = first_set_bit(~mask);
+            *line += count_lines_sse2(chunk, count, next);
+            return s + count;
+        }
+        
+        *line += count_lines_sse2(chunk, 16, next);
+        s += 16;
+    }
+#endif
+    
+    char *start = s;
+    while (s < end && is_whitespace(*s)) s++;
+    *line += count_lines_scalar(start, s - start, s < end ? *s : 0);
+    return s;
+}
+
+// Returns the first char that can't continue an identifier.
+char *
+skip_identifier_chars(char *s, char *end) {
+#ifdef SCAN_SSE2
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)s);
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i ok = _mm_or_si128(_mm_or_si128(sse2_in_range(lower, 'a', 'z'),
+                                               sse2_in_range(chunk, '0', '9')),
+                                  _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+        u32 mask = (u32)_mm_movemask_epi8(ok);
+        
+        if (mask != 0xFFFF) {
+            return s + first_set_bit(~mask);
+        }
+        s += 16;
+    }
+#endif
+    
+    while (s < end && is_valid_identifier_char(false, *s)) s++;
+    return s;
+}
+
+// Returns the first char that can't continue a number.
+char *
+skip_literal_chars(char *s, char *end) {
+#ifdef SCAN_SSE2
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)s);
+        __m128i ok = _mm_or_si128(sse2_in_range(chunk, '0', '9'),
+                                  _mm_cmpeq_epi8(chunk, _mm_set1_epi8('.')));
+        u32 mask = (u32)_mm_movemask_epi8(ok);
+        
+        if (mask != 0xFFFF) {
+            return s + first_set_bit(~mask);
+        }
+        s += 16;
+    }
+#endif
+    
+    while (s < end && is_literal_char(*s)) s++;
+    return s;
+}
+
+// Returns the first '\r' or '\n', or end. Used for skipping comments.
+char *
+find_line_end(char *s, char *end) {
+#ifdef SCAN_SSE2
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)s);
+        __m128i eol = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')),
+                                   _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+        u32 mask = (u32)_mm_movemask_epi8(eol);
+        
+        if (mask) {
+            return s + first_set_bit(mask);
+        }
+        s += 16;
+    }
+#endif
+    
+    while (s < end && *s != '\r' && *s != '\n') s++;
+    return s;
+}
+
+// Returns the first '"', or end, and adds the
+// line breaks we went past to *line.
+char *
+find_quote(char *s, char *end, int *line) {
+#ifdef SCAN_SSE2
+    while (end - s >= 16) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)s);
+        u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+        char next = (end - s > 16) ? s[16] : 0;
+        
+        if (mask) {
+            int count = first_set_bit(mask);
+            *line += count_lines_sse2(chunk, count, next);
+            return s + count;
+        }
+        
+        *line += count_lines_sse2(chunk, 16, next);
+        s += 16;
+    }
+#endif
+    
+    char *start = s;
+    while (s < end && *s != '"') s++;
+    *line += count_lines_scalar(start, s - start, s < end ? *s : 0);
+    return s;
+}
@@ -1,85 +1,262 @@
+u32
+hash_string(const char *string, int length) {
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (u8)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Spreads symbol IDs, which are small and sequential, over a table.
+u32
+hash_symbol(u32 symbol) {
+    return symbol * 2654435761u;
+}
+
 void
-token_new(struct Tokenizer *tokenizer,
-          enum Token_Type type,
-          char data[MAX_TOKEN_LENGTH]) {
-    struct Token *token = calloc(1, sizeof(struct Token));
+symbol_table_grow(struct Symbol_Table *table) {
+    u32 old_capacity = table->id_capacity;
+    u32 *old_ids = table->ids;
+    
+    table->id_capacity = old_capacity ? old_capacity*2 : 1024;
+    table->ids = calloc(table->id_capacity, sizeof(u32));
+    Assert(table->ids);
+    
+    for (u32 i = 0; i < old_capacity; i++) {
+        u32 id = old_ids[i];
+        if (!id) continue;
+        
+        u32 mask = table->id_capacity-1;
+        u32 index = table->symbols[id].hash & mask;
+        while (table->ids[index]) index = (index+1) & mask;
+        table->ids[index] = id;
+    }
+    
+    free(old_ids);
+}
 
-    token->type = type;
-    token->line = tokenizer->current_line;
-    memcpy(token->name, data, strlen(data));
+// Returns the ID for the name, adding it if we haven't seen it yet.
+// The name must outlive the table, since we don't copy it.
+u32
+symbol_intern(struct Symbol_Table *table, const char *name, int length) {
+    // Keep the load factor under 1/2.
+    if ((u32)(table->symbol_count+1)*2 >= table->id_capacity) {
+        symbol_table_grow(table);
+    }
+    
+    u32 hash = hash_string(name, length);
+    u32 mask = table->id_capacity-1;
+    u32 index = hash & mask;
+    
+    while (table->ids[index]) {
+        struct Symbol *symbol = &table->symbols[table->ids[index]];
+        if (symbol->hash == hash &&
+            symbol->length == length &&
+            0==memcmp(symbol->name, name, length))
+        {
+            return table->ids[index];
+        }
+        index = (index+1) & mask;
+    }
+    
+    if (table->symbol_count == table->symbol_capacity) {
+        table->symbol_capacity = table->symbol_capacity ? table->symbol_capacity*2 : 256;
+        table->symbols = realloc(table->symbols, table->symbol_capacity * sizeof(struct Symbol));
+        Assert(table->symbols);
+    }
+    
+    u32 id = (u32)table->symbol_count++;
+    table->symbols[id] = (struct Symbol){name, length, hash};
+    table->ids[index] = id;
+    return id;
+}
 
-    if (!tokenizer->token_start) {
-        tokenizer->token_start = token;
-    } else {
-        token->prev = tokenizer->token_curr;
-        tokenizer->token_curr->next = token;
+// In the order of enum Symbol_ID.
+static const char *builtin_symbol_names[SYMBOL_BUILTIN_COUNT] = {
+    "",
+    "struct", "return", "if", "else", "while", "main", "print",
+    "char", "u8", "int", "i64", "float", "f64", "string",
+};
+
+void
+symbol_table_setup(struct Symbol_Table *table) {
+    const char **builtins = builtin_symbol_names;
+    
+    symbol_table_grow(table);
+    
+    // SYMBOL_NONE only takes up the first ID, it's never looked up.
+    table->symbol_capacity = 256;
+    table->symbols = calloc(table->symbol_capacity, sizeof(struct Symbol));
+    Assert(table->symbols);
+    table->symbols[SYMBOL_NONE].name = builtins[SYMBOL_NONE];
+    table->symbol_count = 1;
+    
+    for (int i = SYMBOL_NONE+1; i < SYMBOL_BUILTIN_COUNT; i++) {
+        u32 id = symbol_intern(table, builtins[i], (int)strlen(builtins[i]));
+        Assert(id == (u32)i);
     }
+}
 
-    tokenizer->token_curr = token;
+void
+symbol_table_free(struct Symbol_Table *table) {
+    free(table->symbols);
+    free(table->ids);
+    *table = (struct Symbol_Table){0};
+}
 
-    tokenizer->token_count++;
+// Copies the symbol's name out as a C string. out must fit MAX_TOKEN_LENGTH chars.
+char *
+symbol_name(struct Symbol_Table *table, u32 id, char *out) {
+    struct Symbol *symbol = &table->symbols[id];
+    memcpy(out, symbol->name, symbol->length);
+    out[symbol->length] = 0;
+    return out;
 }
 
-bool
-is_special_char(char c) {
-    switch (c) {
-        case TOKEN_COLON: case TOKEN_EQUAL: 
-        case TOKEN_ADD: case TOKEN_SUBTRACT: 
-        case TOKEN_MULTIPLY: case TOKEN_DIVIDE:
+// For example,
+// converting the \n to an actual newline instead of backslash and n.
+// Returns the decoded length.
+u64
+parse_string(char *output_string, const char *input_string, u64 length) {
+    const char *s = input_string;
+    u64 output_len = 0;
+    
+    for (u64 i = 0; i < length; i++) {
+        if (s[i] == '\\') {
+            i++;
+            switch (s[i]) {
+                case 'n': {
+                    output_string[output_len++] = '\n';
+                    break;
+                }
+                case 'r': {
+                    output_string[output_len++] = '\r';
+                    break;
+                }
+                case 't': {
+                    output_string[output_len++] = '\t';
+                    break;
+                }
+                case '\\': {
+                    output_string[output_len++] = '\\';
+                    break;
+                }
+            }
+        } else {
+            output_string[output_len++] = s[i];
+        }
+    }
+    
+    return output_len;
+}
+
+// Decodes the literal into tokenizer.constants, and returns its index.
+u32
+constant_new(struct Tokenizer *tokenizer, char *start, int length) {
+    if (tokenizer->constant_count == tokenizer->constant_capacity) {
+        tokenizer->constant_capacity = tokenizer->constant_capacity ? tokenizer->constant_capacity*2 : 256;
+        tokenizer->constants = realloc(tokenizer->constants,
+                                       tokenizer->constant_capacity * sizeof(struct Constant));
+        Assert(tokenizer->constants);
+    }
+    
+    struct Constant *constant = &tokenizer->constants[tokenizer->constant_count];
+    
+    if (*start == '"') {
+        // Skip the surrounding "", and leave room for the terminator.
+        start++;
+        length -= 2;
         
-#if TOKEN_MULTIPLY != TOKEN_POINTER
-        case TOKEN_POINTER: 
-#endif
-        case TOKEN_ADDRESS:
+        struct String *string = arena_alloc(&tokenizer->strings, sizeof(struct String) + length + 1);
+        string->length = parse_string(string->data, start, length);
+        string->data[string->length] = 0;
         
-        case TOKEN_END_STATEMENT:
-        case TOKEN_OPEN_FUNCTION: case TOKEN_CLOSE_FUNCTION:
-        case TOKEN_OPEN_SCOPE: case TOKEN_CLOSE_SCOPE:
-        case TOKEN_COMMA: case '"':
-        return true;
+        constant->type = CONSTANT_STRING;
+        constant->string = string;
+    } else {
+        // strtoll() and strtod() need a terminated string.
+        char number[MAX_TOKEN_LENGTH];
+        memcpy(number, start, length);
+        number[length] = 0;
+        
+        if (memchr(number, '.', length)) {
+            constant->type = CONSTANT_FLOAT;
+            constant->float_value = strtod(number, NULL);
+        } else {
+            constant->type = CONSTANT_INT;
+            constant->int_value = strtoll(number, NULL, 10);
+        }
     }
-    return false;
+    
+    return tokenizer->constant_count++;
 }
 
-bool
-is_valid_identifier_char(bool first, char c) {
-    if (!first) {
-        if (c >= '0' && c <= '9') {
-            return true;
-        }
+void
+token_new(struct Tokenizer *tokenizer,
+          enum Token_Type type,
+          char *start,
+          int length) {
+    // String literals are only limited by token->length.
+    Assert(length < (*start == '"' ? 0xFFFF : MAX_TOKEN_LENGTH));
+
+    // Leave room for the TOKEN_NONE at the end.
+    if (tokenizer->token_count+1 >= tokenizer->token_capacity) {
+        tokenizer->token_capacity *= 2;
+        tokenizer->tokens = realloc(tokenizer->tokens,
+                                    tokenizer->token_capacity * sizeof(struct Token));
+        Assert(tokenizer->tokens);
     }
 
-    if (c == '_' || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
-        return true;
+    struct Token *token = &tokenizer->tokens[tokenizer->token_count++];
+
+    token->type = (u8)type;
+    token->identifier_type = IDENTIFIER_NONE;
+    token->line = tokenizer->current_line;
+    token->offset = (u32)(start - tokenizer->buffer);
+    token->length = (u16)length;
+    token->symbol = SYMBOL_NONE;
+    token->slot = -1;
+    
+    if (type == TOKEN_IDENTIFIER) {
+        token->symbol = symbol_intern(&tokenizer->symbols, start, length);
+    } else if (type == TOKEN_LITERAL) {
+        token->constant = constant_new(tokenizer, start, length);
     }
+}
 
-    return false;
+char *
+token_text(struct Tokenizer *tokenizer, struct Token *token) {
+    return tokenizer->buffer + token->offset;
 }
 
-bool
-is_literal_char(char c) {
-    return (c >= '0' && c <= '9') || c == '.';
+// Copies the token's text out as a C string. out must fit token->length+1 chars.
+char *
+token_name(struct Tokenizer *tokenizer, struct Token *token, char *out) {
+    memcpy(out, token_text(tokenizer, token), token->length);
+    out[token->length] = 0;
+    return out;
 }
 
-bool
-is_whitespace(char c) {
-    switch (c) {
-        case '\n': case '\r': case ' ': case '\t':
-        return true;
-    }
-    return false;
+struct Token *
+matching_brace(struct Tokenizer *tokenizer, struct Token *brace) {
+    Assert(brace->type == TOKEN_OPEN_SCOPE || brace->type == TOKEN_CLOSE_SCOPE);
+    return &tokenizer->tokens[brace->match];
 }
 
 // function :: (...) {...}
+//
+// These never look past the TOKEN_NONE at the end,
+// since the && stops at the first mismatch.
 bool
 is_function_def(struct Token *token) {
     Assert(token);
-    if (!token->next || !token->next->next || !token->next->next->next) return false;
     if (token->type != TOKEN_IDENTIFIER) return false;
 
-    if (token->next->type == TOKEN_COLON &&
-        token->next->next->type == TOKEN_COLON &&
-        token->next->next->next->type == TOKEN_OPEN_FUNCTION)
+    if (token[1].type == TOKEN_COLON &&
+        token[2].type == TOKEN_COLON &&
+        token[3].type == TOKEN_OPEN_FUNCTION)
     {
         return true;
     }
@@ -89,10 +266,9 @@ is_function_def(struct Token *token) {
 bool
 is_function_call(struct Token *token) {
     Assert(token);
-    if (!token->next) return false;
     if (token->type != TOKEN_IDENTIFIER) return false;
 
-    if (token->next->type == TOKEN_OPEN_FUNCTION)
+    if (token[1].type == TOKEN_OPEN_FUNCTION)
         return true;
     return false;
 }
@@ -101,128 +277,233 @@ is_function_call(struct Token *token) {
 bool
 is_struct_name(struct Token *token) {
     Assert(token);
-    if (!token->next || !token->next->next || !token->next->next->next) return false;
     if (token->type != TOKEN_IDENTIFIER) return false;
 
-    if (token->next->type == TOKEN_COLON &&
-        token->next->next->type == TOKEN_COLON &&
-        0==strcmp(token->next->next->next->name, "struct"))
+    if (token[1].type == TOKEN_COLON &&
+        token[2].type == TOKEN_COLON &&
+        token[3].symbol == SYMBOL_STRUCT)
     {
         return true;
     }
     return false;
 }
 
+// Errors end the program, unless the tokenizer has somewhere
+// to jump back to, like the REPL does.
+void
+tokenizer_fail(struct Tokenizer *tokenizer) {
+    if (tokenizer->on_error) {
+        longjmp(*tokenizer->on_error, 1);
+    }
+    exit(1);
+}
+
+// Reports a compile error, then fails. Doesn't return.
+void
+tokenizer_error(struct Tokenizer *tokenizer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (tokenizer->error_message) {
+        vsnprintf(tokenizer->error_message, ERROR_MESSAGE_SIZE, format, args);
+    } else {
+        vfprintf(stderr, format, args);
+    }
+    va_end(args);
+    
+    tokenizer_fail(tokenizer);
+}
+
+// Points every { and } from token `first` on at the other one, so the
+// blocks of ifs, whiles and functions can be stepped over in one go.
+// The tokens before `first` have to be matched up already.
+void
+match_braces(struct Tokenizer *tokenizer, int first) {
+    int *open = NULL; // Indices of the { we're still inside.
+    int depth = 0, capacity = 0;
+    
+    for (int i = first; i < tokenizer->token_count; i++) {
+        struct Token *tok = &tokenizer->tokens[i];
+        
+        if (tok->type == TOKEN_OPEN_SCOPE) {
+            if (depth == capacity) {
+                capacity = capacity ? capacity*2 : 64;
+                open = realloc(open, capacity * sizeof(int));
+                Assert(open);
+            }
+            open[depth++] = i;
+        } else if (tok->type == TOKEN_CLOSE_SCOPE) {
+            if (depth == 0) {
+                free(open);
+                tokenizer_error(tokenizer, "Error: %s(%d)\n  This } doesn't close anything!\n", tokenizer->file_name, tok->line);
+            }
+            int match = open[--depth];
+            tok->match = (u32)match;
+            tokenizer->tokens[match].match = (u32)i;
+        }
+    }
+    
+    if (depth) {
+        int line = tokenizer->tokens[open[depth-1]].line;
+        free(open);
+        tokenizer_error(tokenizer, "Error: %s(%d)\n  This { is never closed!\n", tokenizer->file_name, line);
+    }
+    
+    free(open);
+}
+
+// Sets up a tokenizer with no tokens yet. tokenize_more() does the work.
 struct Tokenizer
-tokenize(const char *file_name, char *source_buffer) {
+tokenizer_new(const char *file_name, char *source_buffer, u64 expected_length) {
     struct Tokenizer tokenizer = {0};
     
-    strcpy(tokenizer.file_name, file_name);
+    snprintf(tokenizer.file_name, sizeof(tokenizer.file_name), "%s", file_name);
     tokenizer.buffer = source_buffer;
     tokenizer.current_line = 1;
+    
+    symbol_table_setup(&tokenizer.symbols);
+    
+    // A rough guess at the token count so we rarely grow.
+    tokenizer.token_capacity = (int)(expected_length/4) + 16;
+    tokenizer.tokens = malloc(tokenizer.token_capacity * sizeof(struct Token));
+    Assert(tokenizer.tokens);
+    tokenizer.tokens[0] = (struct Token){ .line = 1 };
+    
+    return tokenizer;
+}
 
-    char *s = tokenizer.buffer;
-
-    enum Token_Type current_token_type = TOKEN_NONE;
-    char current_token[MAX_TOKEN_LENGTH] = {0};
-    int current_token_len = 0;
-
-    bool string = false; // Are we in a string?
+void
+tokenizer_free(struct Tokenizer *tokenizer) {
+    if (tokenizer->cache.data) {
+        platform_unmap_file(&tokenizer->cache);
+    } else {
+        free(tokenizer->tokens);
+        free(tokenizer->function_defs);
+        symbol_table_free(&tokenizer->symbols);
+        free(tokenizer->constants);
+    }
+    
+    tokenizer->tokens = NULL;
+    tokenizer->token_count = tokenizer->token_capacity = 0;
+    tokenizer->function_defs = NULL;
+    tokenizer->function_def_count = tokenizer->function_def_capacity = 0;
+    tokenizer->symbols = (struct Symbol_Table){0};
+    tokenizer->constants = NULL;
+    tokenizer->constant_count = tokenizer->constant_capacity = 0;
+    arena_free(&tokenizer->strings);
+}
 
-    while (*s) {
-        if (*s == '/' && *(s+1) == '/') {
-            // Continue till EOL or EOF
-            while (*s) {
-                if (*s == '\r' || *s == '\n') {
-                    break;
-                }
-                ++s;
-            }
-        }
+// Scans tokens from s on, starting none at or after stop, though the
+// last one can run on up to end. Returns where it stopped, which is past
+// stop if a string or some whitespace ran over it.
+//
+// A speculative scan might have started in the middle of a string, so
+// it doesn't report anything that looks wrong, it just returns NULL and
+// leaves it to a scan from the right place to say what the error is.
+char *
+tokenize_range(struct Tokenizer *tokenizer, char *s, char *stop, char *end, bool speculative) {
+    // Each pass takes one whole token (or run of whitespace, or comment),
+    // so the scanners in scan.c can chew through it in big steps.
+    while (s < stop) {
+        u8 c = (u8)*s;
+        u8 char_class = char_classes[c];
         
-        if (string) {
-            current_token[current_token_len++] = *s;
-            current_token_type = TOKEN_LITERAL;
-
-            if (*s == '"') {
-                string = false;
-
-                // At this point, current_token_type = TOKEN_LITERAL
-                // unless the string looks like this ""
-                token_new(&tokenizer, current_token_type, current_token);
-                memset(current_token, 0, MAX_TOKEN_LENGTH);
-                current_token_len = 0;
-
-                ++s;
-                continue;
+        if (char_class & CHAR_WHITESPACE) {
+            s = skip_whitespace(s, end, &tokenizer->current_line);
+        } else if (char_class & CHAR_LETTER) {
+            char *start = s;
+            s = skip_identifier_chars(s+1, end);
+            if (s - start >= MAX_TOKEN_LENGTH) {
+                if (speculative) return NULL;
+                tokenizer_error(tokenizer, "Error: %s(%d)\n  This name is too long!\n", tokenizer->file_name, tokenizer->current_line);
             }
-
-            ++s;
-            continue;
-        }
-
-        if (is_whitespace(*s)) {
-            // Close off the current identifier if we have one.
-            if (current_token_len) {
-                token_new(&tokenizer, current_token_type, current_token);
-                memset(current_token, 0, MAX_TOKEN_LENGTH);
-                current_token_len = 0;
+            token_new(tokenizer, TOKEN_IDENTIFIER, start, (int)(s - start));
+        } else if (char_class & (CHAR_DIGIT|CHAR_DOT)) {
+            char *start = s;
+            s = skip_literal_chars(s+1, end);
+            if (s - start >= MAX_TOKEN_LENGTH) {
+                if (speculative) return NULL;
+                tokenizer_error(tokenizer, "Error: %s(%d)\n  This number is too long!\n", tokenizer->file_name, tokenizer->current_line);
             }
-            current_token_type = 0;
+            token_new(tokenizer, TOKEN_LITERAL, start, (int)(s - start));
+        } else if (c == '/' && s+1 < end && s[1] == '/') {
+            // Continue till EOL or EOF
+            s = find_line_end(s+2, end);
+        } else if (c == '"') {
+            // The token includes both quotes, and is on the line it starts on.
+            char *start = s;
+            int newlines = 0;
             
-            if (*s == '\r' || *s == '\n') {
-                if (*s == '\r' && *(s+1) == '\n') {
-                    ++s; // So only one \r will be tokenized instead of two.
-                }
-                tokenizer.current_line++;
+            s = find_quote(s+1, end, &newlines);
+            if (s == end) {
+                if (speculative) return NULL;
+                tokenizer_error(tokenizer, "Error: %s(%d)\n  Unterminated string!\n", tokenizer->file_name, tokenizer->current_line);
             }
+            s++;
             
-            ++s;
-            continue;
-        }
-
-        // Check if the current char is any special character.
-        if (is_special_char(*s)) {
-            // Close off the current identifier if we have one.
-            if (current_token_len) {
-                token_new(&tokenizer, current_token_type, current_token);
-                memset(current_token, 0, MAX_TOKEN_LENGTH);
-                current_token_len = 0;
+            if (s - start >= 0xFFFF) {
+                if (speculative) return NULL;
+                tokenizer_error(tokenizer, "Error: %s(%d)\n  This string is too long!\n", tokenizer->file_name, tokenizer->current_line);
             }
-
-            if (*s == '"') {
-                current_token[current_token_len++] = *s;
-                current_token_type = TOKEN_LITERAL;
-                string = true;
-            } else {
-                char data[MAX_TOKEN_LENGTH] = {*s, 0};
-                token_new(&tokenizer, *s, data);
+            token_new(tokenizer, TOKEN_LITERAL, start, (int)(s - start));
+            tokenizer->current_line += newlines;
+        } else if (c == '-' && s+1 < end && s[1] == '>') {
+            token_new(tokenizer, TOKEN_ARROW, s, 2);
+            s += 2;
+        } else if ((c == '=' || c == '!' || c == '<' || c == '>') && s+1 < end && s[1] == '=') {
+            enum Token_Type type = TOKEN_EQUAL_EQUAL;
+            switch (c) {
+                case '!': type = TOKEN_NOT_EQUAL; break;
+                case '<': type = TOKEN_LESS_EQUAL; break;
+                case '>': type = TOKEN_GREATER_EQUAL; break;
             }
-        } else if (current_token_type != TOKEN_LITERAL &&
-                   is_valid_identifier_char(current_token_len == 0, *s))
-        {
-            Assert(current_token_len <= MAX_TOKEN_LENGTH);
-            current_token[current_token_len++] = *s;
-            current_token_type = TOKEN_IDENTIFIER;
-        } else if (is_literal_char(*s)) {
-            Assert(current_token_type == TOKEN_LITERAL || current_token_len == 0); // We can't start a literal while we're in another token!
-            current_token[current_token_len++] = *s;
-            current_token_type = TOKEN_LITERAL;
+            token_new(tokenizer, type, s, 2);
+            s += 2;
+        } else if (char_class & CHAR_SPECIAL) {
+            token_new(tokenizer, c, s, 1);
+            s++;
+        } else {
+            s++; // Nothing we know about, so skip it.
         }
+    }
+
+    return s;
+}
 
-        ++s;
+// Close off the token list.
+void
+tokens_terminate(struct Tokenizer *tokenizer) {
+    tokenizer->tokens[tokenizer->token_count] = (struct Token){0};
+    tokenizer->tokens[tokenizer->token_count].line = tokenizer->current_line;
+}
+
+void
+function_def_add(struct Tokenizer *tokenizer, u32 token_index) {
+    if (tokenizer->function_def_count == tokenizer->function_def_capacity) {
+        tokenizer->function_def_capacity = tokenizer->function_def_capacity ? tokenizer->function_def_capacity*2 : 64;
+        tokenizer->function_defs = realloc(tokenizer->function_defs,
+                                           tokenizer->function_def_capacity * sizeof(u32));
+        Assert(tokenizer->function_defs);
     }
+    tokenizer->function_defs[tokenizer->function_def_count++] = token_index;
+}
 
-    // Set all identifier types.
-    for (struct Token *tok = tokenizer.token_start; tok; tok = tok->next) {
+// Sets the identifier types of tokens[first] up to tokens[last], and adds the
+// function definitions among them on to tokenizer.function_defs. The tokens
+// don't have to be the tokenizer's own, so that pieces of them can be done
+// at the same time, each with its own list of definitions.
+void
+classify_identifiers(struct Tokenizer *tokenizer, struct Token *tokens, int first, int last) {
+    for (int i = first; i < last; i++) {
+        struct Token *tok = &tokens[i];
         if (tok->type != TOKEN_IDENTIFIER) continue;
 
         tok->identifier_type = IDENTIFIER_NONE;
 
-        if (0==strcmp(tok->name, "struct")) {
+        if (tok->symbol >= SYMBOL_STRUCT && tok->symbol <= SYMBOL_WHILE) {
             tok->identifier_type = IDENTIFIER_KEYWORD;
         } else if (is_function_def(tok)) {
             tok->identifier_type = IDENTIFIER_FUNCTION_DEF;
+            function_def_add(tokenizer, (u32)i);
         } else if (is_function_call(tok)) {
             tok->identifier_type = IDENTIFIER_FUNCTION_CALL;
         } else if (is_struct_name(tok)) {
@@ -231,16 +512,278 @@ tokenize(const char *file_name, char *source_buffer) {
             tok->identifier_type = IDENTIFIER_VARIABLE_OR_TYPE;
         }
     }
+}
+
+// Tokenizes the source from buffer_length up to new_length, and adds the
+// tokens on to the end. Only the new tokens get their braces matched and
+// their identifiers classified, so the cost is in what was added, not in
+// everything before it. The new source can't start or end inside a token.
+// Returns the index of the first new token.
+int
+tokenize_more(struct Tokenizer *tokenizer, u64 new_length) {
+    int first = tokenizer->token_count;
+    
+    char *s = tokenizer->buffer + tokenizer->buffer_length;
+    char *end = tokenizer->buffer + new_length;
+    tokenizer->buffer_length = new_length;
+    
+    tokenize_range(tokenizer, s, end, end, false);
+    tokens_terminate(tokenizer);
+    
+    match_braces(tokenizer, first);
+    classify_identifiers(tokenizer, tokenizer->tokens, first, tokenizer->token_count);
+
+    return first;
+}
+
+// Big sources are split into chunks that are tokenized at the same time.
+#define TOKENIZE_PARALLEL_MIN Megabytes(1)
+#define TOKENIZE_CHUNK_MIN    Kilobytes(256)
+
+// Where a chunk can start has to be somewhere the scan before it stops,
+// and the scan of the chunk starts, the same way they'd go through it in
+// one go. Comments end at the newline, so the start of a line that isn't
+// indented is good, as long as it's not inside a string. There's no
+// telling that without scanning everything before it, so each chunk is
+// tokenized as if it isn't, and chunks that were wrong are done again.
+struct Token_Chunk {
+    // Tokens, symbols and constants of just this chunk. Tokens have
+    // their real offsets, but lines and everything else are its own.
+    struct Tokenizer tokenizer;
+    
+    char *start, *stop;
+    char *scanned_to; // Where the scan actually stopped, or NULL if it failed.
+    
+    int line;          // Added on to the line of each token.
+    int token_base;    // Where its tokens go in the whole list.
+    int constant_base; // Same for its constants.
+    u32 *symbols;      // Its symbol IDs to the real ones.
+};
+
+struct Parallel_Tokenize {
+    struct Tokenizer *tokenizer;
+    struct Token_Chunk *chunks;
+    int chunk_count;
+    
+    // The merged tokens are classified in this many even ranges, each
+    // with a tokenizer of its own that only holds its function_defs.
+    struct Tokenizer *ranges;
+};
+
+void
+tokenize_chunk_work(void *data, int index, int thread) {
+    struct Parallel_Tokenize *job = data;
+    struct Token_Chunk *chunk = &job->chunks[index];
+    char *end = job->tokenizer->buffer + job->tokenizer->buffer_length;
+    
+    chunk->scanned_to = tokenize_range(&chunk->tokenizer, chunk->start, chunk->stop, end, true);
+}
+
+void
+merge_chunk_work(void *data, int index, int thread) {
+    struct Parallel_Tokenize *job = data;
+    struct Token_Chunk *chunk = &job->chunks[index];
+    struct Tokenizer *tokenizer = job->tokenizer;
+    
+    struct Token *tokens = tokenizer->tokens + chunk->token_base;
+    for (int i = 0; i < chunk->tokenizer.token_count; i++) {
+        struct Token token = chunk->tokenizer.tokens[i];
+        token.line += chunk->line;
+        if (token.type == TOKEN_IDENTIFIER) {
+            token.symbol = chunk->symbols[token.symbol];
+        } else if (token.type == TOKEN_LITERAL) {
+            token.constant += (u32)chunk->constant_base;
+        }
+        tokens[i] = token;
+    }
+    
+    memcpy(tokenizer->constants + chunk->constant_base, chunk->tokenizer.constants,
+           chunk->tokenizer.constant_count * sizeof(struct Constant));
+}
 
+void
+classify_range_work(void *data, int index, int thread) {
+    struct Parallel_Tokenize *job = data;
+    int token_count = job->tokenizer->token_count;
+    
+    classify_identifiers(&job->ranges[index], job->tokenizer->tokens,
+                         (int)((s64)token_count * index / job->chunk_count),
+                         (int)((s64)token_count * (index+1) / job->chunk_count));
+}
+
+void
+token_chunks_free(struct Token_Chunk *chunks, int chunk_count) {
+    for (int i = 0; i < chunk_count; i++) {
+        tokenizer_free(&chunks[i].tokenizer);
+        free(chunks[i].symbols);
+    }
+    free(chunks);
+}
+
+// Tokenizes the source of a new tokenizer, up to source_length. Gives
+// exactly the same result as tokenize_more() would, down to the symbol
+// IDs, however it gets split up. Errors are reported the same way too,
+// with nothing left over but what tokenizer_free() frees.
+void
+tokenize_parallel(struct Tokenizer *tokenizer, u64 source_length, int chunk_count) {
+    char *source_buffer = tokenizer->buffer;
+    char *end = source_buffer + source_length;
+    tokenizer->buffer_length = source_length;
+    
+    struct Token_Chunk *chunks = calloc(chunk_count, sizeof(struct Token_Chunk));
+    Assert(chunks);
+    
+    // Move each split on to the start of an unindented line. Chunks
+    // that don't have one are left empty.
+    char *previous = source_buffer;
+    for (int i = 0; i < chunk_count; i++) {
+        char *start = source_buffer + source_length * i / chunk_count;
+        if (start < previous) start = previous;
+        
+        if (i > 0) {
+            for (;;) {
+                start = memchr(start, '\n', end - start);
+                if (!start) {
+                    start = end;
+                    break;
+                }
+                start++;
+                if (start == end || !(char_classes[(u8)*start] & CHAR_WHITESPACE)) break;
+            }
+        }
+        
+        chunks[i].start = start;
+        if (i > 0) chunks[i-1].stop = start;
+        previous = start;
+    }
+    chunks[chunk_count-1].stop = end;
+    
+    for (int i = 0; i < chunk_count; i++) {
+        struct Token_Chunk *chunk = &chunks[i];
+        chunk->tokenizer = tokenizer_new(tokenizer->file_name, source_buffer, chunk->stop - chunk->start);
+        chunk->tokenizer.current_line = 0;
+    }
+    
+    int thread_count = platform_thread_count(chunk_count);
+    struct Parallel_Tokenize job = { tokenizer, chunks, chunk_count, NULL };
+    platform_parallel_for(chunk_count, thread_count, tokenize_chunk_work, &job);
+    
+    // Now that it's known where each scan really stopped, redo the chunks
+    // that started in the wrong place, in order, and work out where the
+    // tokens, constants and lines of each one go.
+    int line = 1;
+    int token_count = 0, constant_count = 0;
+    char *at = source_buffer;
+    
+    for (int i = 0; i < chunk_count; i++) {
+        struct Token_Chunk *chunk = &chunks[i];
+        
+        if (!chunk->scanned_to || chunk->start != at) {
+            tokenizer_free(&chunk->tokenizer);
+            chunk->tokenizer = tokenizer_new(tokenizer->file_name, source_buffer, 0);
+            chunk->tokenizer.current_line = line;
+            
+            char *stop = chunk->stop > at ? chunk->stop : at;
+            chunk->scanned_to = tokenize_range(&chunk->tokenizer, at, stop, end, true);
+            
+            if (!chunk->scanned_to) {
+                // It's a real error this time. Scanning from the same
+                // place again runs into it, and reports it.
+                token_chunks_free(chunks, chunk_count);
+                tokenizer->current_line = line;
+                tokenize_range(tokenizer, at, end, end, false);
+                Assert(!"The error wasn't found again.");
+            }
+            
+            chunk->line = 0;
+            line = chunk->tokenizer.current_line;
+        } else {
+            chunk->line = line;
+            line += chunk->tokenizer.current_line;
+        }
+        at = chunk->scanned_to;
+        
+        chunk->token_base = token_count;
+        chunk->constant_base = constant_count;
+        token_count += chunk->tokenizer.token_count;
+        constant_count += chunk->tokenizer.constant_count;
+        
+        // Interning in order gives the same IDs as one scan would.
+        struct Symbol_Table *symbols = &chunk->tokenizer.symbols;
+        chunk->symbols = malloc(symbols->symbol_count * sizeof(u32));
+        Assert(chunk->symbols);
+        for (int id = 0; id < symbols->symbol_count; id++) {
+            struct Symbol *symbol = &symbols->symbols[id];
+            chunk->symbols[id] = id < SYMBOL_BUILTIN_COUNT ? (u32)id : symbol_intern(&tokenizer->symbols, symbol->name, symbol->length);
+        }
+        
+        // The strings stay where they are, so the constants can be copied as they are.
+        arena_take(&tokenizer->strings, &chunk->tokenizer.strings);
+    }
+    
+    tokenizer->current_line = line;
+    
+    free(tokenizer->tokens);
+    tokenizer->token_count = token_count;
+    tokenizer->token_capacity = token_count+1;
+    tokenizer->tokens = malloc(tokenizer->token_capacity * sizeof(struct Token));
+    Assert(tokenizer->tokens);
+    
+    tokenizer->constant_count = tokenizer->constant_capacity = constant_count;
+    tokenizer->constants = malloc((constant_count ? constant_count : 1) * sizeof(struct Constant));
+    Assert(tokenizer->constants);
+    
+    platform_parallel_for(chunk_count, thread_count, merge_chunk_work, &job);
+    tokens_terminate(tokenizer);
+    token_chunks_free(chunks, chunk_count);
+    
+    // Braces can be matched across chunks, so that's done in one go.
+    match_braces(tokenizer, 0);
+    
+    job.chunks = NULL;
+    job.ranges = calloc(chunk_count, sizeof(struct Tokenizer));
+    Assert(job.ranges);
+    platform_parallel_for(chunk_count, thread_count, classify_range_work, &job);
+    
+    for (int i = 0; i < chunk_count; i++) {
+        struct Tokenizer *range = &job.ranges[i];
+        for (int j = 0; j < range->function_def_count; j++) {
+            function_def_add(tokenizer, range->function_defs[j]);
+        }
+        free(range->function_defs);
+    }
+    free(job.ranges);
+}
+
+// Tokenizes all of a new tokenizer's source, which is source_length long.
+void
+tokenize_all(struct Tokenizer *tokenizer, u64 source_length) {
+    int core_count = platform_core_count();
+    if (source_length >= TOKENIZE_PARALLEL_MIN && core_count > 1) {
+        // A few chunks per core, so one slow chunk doesn't hold everything up.
+        u64 chunk_count = source_length / TOKENIZE_CHUNK_MIN;
+        if (chunk_count > (u64)core_count*4) chunk_count = (u64)core_count*4;
+        tokenize_parallel(tokenizer, source_length, (int)chunk_count);
+    } else {
+        tokenize_more(tokenizer, source_length);
+    }
+}
+
+// The source doesn't have to be null terminated, so it
+// can be scanned in place straight out of a file mapping.
+struct Tokenizer
+tokenize(const char *file_name, char *source_buffer, u64 source_length) {
+    struct Tokenizer tokenizer = tokenizer_new(file_name, source_buffer, source_length);
+    tokenize_all(&tokenizer, source_length);
     return tokenizer;
 }
 
 void
 print_tokens(struct Tokenizer *tokenizer) {
-    struct Token *start = tokenizer->token_start;
-    Log("Token Count: %u\n", tokenizer->token_count);
+    Log("Token Count: %d\n", tokenizer->token_count);
 
-    for (struct Token *tok = start; tok; tok = tok->next) {
+    for (int i = 0; i < tokenizer->token_count; i++) {
+        struct Token *tok = &tokenizer->tokens[i];
         enum Token_Type type = tok->type;
 
         char name[32] = {0};
@@ -277,6 +820,6 @@ print_tokens(struct Tokenizer *tokenizer) {
             sprintf(identifier_type, " | Identifier Type: %s", str);
         }
 
-        Log("Token: %s \"%s\"%s\n", name, tok->name, identifier_type);
+        Log("Token: %s \"%.*s\"%s\n", name, tok->length, token_text(tokenizer, tok), identifier_type);
     }
 }
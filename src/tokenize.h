@@ -10,6 +10,9 @@ enum Token_Type {
     
     TOKEN_EQUAL = '=',
     
+    TOKEN_LESS = '<',
+    TOKEN_GREATER = '>',
+    
     TOKEN_ADD = '+',
     TOKEN_SUBTRACT = '-',
     TOKEN_DIVIDE = '/',
@@ -24,33 +27,142 @@ enum Token_Type {
     TOKEN_CLOSE_FUNCTION = ')',
     TOKEN_OPEN_SCOPE = '{',
     TOKEN_CLOSE_SCOPE = '}',
+    
+    // Multi-character tokens start after ASCII.
+    TOKEN_ARROW = 128, // ->
+    TOKEN_EQUAL_EQUAL,   // ==
+    TOKEN_NOT_EQUAL,     // !=
+    TOKEN_LESS_EQUAL,    // <=
+    TOKEN_GREATER_EQUAL, // >=
 };
 
 enum Identifier_Type {
     IDENTIFIER_NONE,
     IDENTIFIER_VARIABLE_OR_TYPE,
-    IDENTIFIER_KEYWORD,      // eg: the struct in  "Vector :: struct {"
+    IDENTIFIER_KEYWORD,      // eg: the struct in  "Vector :: struct {", return, if, else or while
     IDENTIFIER_FUNCTION_DEF, // eg: the main in    "main :: () {"
     IDENTIFIER_FUNCTION_CALL,
     IDENTIFIER_STRUCT_DEF,   // eg: the Vector in  "Vector :: struct {"
 };
 
-struct Token {
-    int line; // Line in source code file.
+// Every identifier is interned once while tokenizing, so the
+// rest of the interpreter compares symbol IDs instead of strings.
+//
+// These are interned up front, in this order, so their IDs are fixed.
+enum Symbol_ID {
+    SYMBOL_NONE,
     
-    enum Token_Type type;
-    enum Identifier_Type identifier_type;
-    char name[MAX_TOKEN_LENGTH];
+    // The keywords.
+    SYMBOL_STRUCT,
+    SYMBOL_RETURN,
+    SYMBOL_IF,
+    SYMBOL_ELSE,
+    SYMBOL_WHILE,
+    
+    SYMBOL_MAIN,
+    SYMBOL_PRINT,
+    
+    SYMBOL_CHAR,
+    SYMBOL_U8,
+    SYMBOL_INT,
+    SYMBOL_I64,
+    SYMBOL_FLOAT,
+    SYMBOL_F64,
+    SYMBOL_STRING,
+    
+    SYMBOL_BUILTIN_COUNT
+};
+
+struct Symbol {
+    const char *name; // Not terminated. Points into the source or a string constant.
+    int length;
+    u32 hash;
+};
+
+// Open addressing hash table from names to symbol IDs.
+struct Symbol_Table {
+    struct Symbol *symbols; // Indexed by symbol ID. symbols[SYMBOL_NONE] is unused.
+    int symbol_count, symbol_capacity;
+    
+    u32 *ids; // 0 means empty, since SYMBOL_NONE is never stored.
+    u32 id_capacity; // Always a power of two.
+};
+
+enum Constant_Type {
+    CONSTANT_INT,
+    CONSTANT_FLOAT,
+    CONSTANT_STRING,
+};
 
-    struct Token *prev, *next;
+// Strings are immutable, so they're shared instead of copied, and
+// their length is always known. This is how long ones are stored;
+// see union Value for the short ones.
+struct String {
+    u64 length;
+    char data[]; // Also null terminated.
+};
+
+// Every literal is decoded once, while tokenizing.
+struct Constant {
+    u8 type; // enum Constant_Type
+    union {
+        s64 int_value;
+        f64 float_value;
+        struct String *string; // In tokenizer.strings.
+    };
+};
+
+// Tokens don't own their text, they point into tokenizer.buffer.
+struct Token {
+    u32 offset; // Into tokenizer.buffer.
+    u16 length;
+    u8 type;            // enum Token_Type
+    u8 identifier_type; // enum Identifier_Type
+    
+    int line; // Line in source code file.
+    union {
+        u32 symbol;   // For identifiers.
+        u32 constant; // For literals, an index into tokenizer.constants.
+        u32 match;    // For { and }, the index of the other one.
+    };
+    int slot; // Set by the resolver for variables, -1 otherwise.
 };
 
 struct Tokenizer {
     char file_name[256];
     char *buffer; // The actual source file.
+    u64 buffer_length;
     
     int current_line;
 
-    struct Token *token_start, *token_curr;
-    unsigned token_count;
+    // All tokens in source order. tokens[token_count] is always
+    // a TOKEN_NONE, so looking at tok+1 is safe for any token,
+    // and the next/previous token is simply the neighbouring index.
+    struct Token *tokens;
+    int token_count, token_capacity;
+    
+    // Token indices of the names of all function definitions, in order.
+    u32 *function_defs;
+    int function_def_count, function_def_capacity;
+    
+    struct Symbol_Table symbols;
+    
+    struct Constant *constants;
+    int constant_count, constant_capacity;
+    
+    // The decoded string literals. Values point right at them, so
+    // they can't move when more source is tokenized.
+    struct Arena strings;
+    
+    // Errors longjmp here instead of exiting, if it's set.
+    // That's how the REPL throws away a bad input and carries on.
+    jmp_buf *on_error;
+    
+    // Compile errors are written here instead of to stderr, if it's set.
+    // It holds ERROR_MESSAGE_SIZE chars. See run_function_pass().
+    char *error_message;
+    
+    // If everything above was loaded from a cache file, it's all in
+    // this mapping instead of on the heap. See cache.c.
+    struct Mapped_File cache;
 };
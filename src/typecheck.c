@@ -0,0 +1,355 @@
+// Runs after the resolver. Parses the statements of every function,
+// works out the type of every expression and variable, and reports
+// any mismatch before the program starts. The compiler then just
+// reads the types written into the tree here.
+
+struct Function *program_find_function(struct Program *program, u32 symbol);
+enum Type check_expression(struct Interpreter *interp, struct Function *func, struct Expr *expr);
+
+// Checks a value that has to have `type`, or infers
+// it when type is TYPE_NONE. Integer constants convert
+// to any number type, so "x : float = 1;" works.
+enum Type
+check_value(struct Interpreter *interp, struct Function *func, struct Expr *expr, enum Type type) {
+    if (expr->kind == EXPR_CONSTANT && expr->type == TYPE_S64) {
+        if (type == TYPE_F64) {
+            expr->value.f64 = (f64)expr->value.s64;
+            expr->type = TYPE_F64;
+        } else if (type == TYPE_U8) {
+            expr->value.u8 = (u8)expr->value.s64;
+            expr->type = TYPE_U8;
+        }
+    }
+    
+    enum Type result = check_expression(interp, func, expr);
+    
+    if (type && result != type) {
+        CompileError(interp, expr->token, "Value does not have the type expected here.");
+    }
+    
+    return result;
+}
+
+// Returns the callee's return type, which is TYPE_NONE if it has none.
+enum Type
+check_call(struct Interpreter *interp, struct Function *func, struct Expr *call) {
+    struct Function *callee = program_find_function(&interp->program, call->token->symbol);
+    if (!callee) {
+        char name[MAX_TOKEN_LENGTH];
+        CompileError1(interp, call->token, "%s is not defined",
+                      token_name(&interp->tokenizer, call->token, name));
+    }
+    
+    if (callee->sys_function == SYSCALL_PRINT && call->call.arg_count > 1) {
+        CompileError(interp, call->token, "print() only takes one parameter");
+    }
+    if (call->call.arg_count != callee->parameter_count) {
+        CompileError1(interp, call->token, "Function %s does not take that amount of arguments!", callee->name);
+    }
+    
+    for (int i = 0; i < call->call.arg_count; i++) {
+        // print() takes anything, so its parameter has no type.
+        // Note:
+        //   The first `parameter_count` slots
+        //   are always the parameters.
+        enum Type type = callee->sys_function == SYSCALL_PRINT ? TYPE_NONE : callee->slot_types[i];
+        check_value(interp, func, call->call.args[i], type);
+    }
+    
+    call->call.function = callee;
+    return callee->return_type;
+}
+
+enum Type
+check_expression(struct Interpreter *interp, struct Function *func, struct Expr *expr) {
+    switch (expr->kind) {
+        case EXPR_CONSTANT: {
+            break;
+        }
+        
+        case EXPR_VARIABLE: {
+            expr->type = (u8)func->slot_types[expr->slot];
+            break;
+        }
+        
+        case EXPR_CALL: {
+            expr->type = (u8)check_call(interp, func, expr);
+            
+            // Only a call used as a statement can be void.
+            if (expr->type == TYPE_NONE) {
+                CompileError1(interp, expr->token, "%s() does not return a value.", expr->call.function->name);
+            }
+            break;
+        }
+        
+        case EXPR_NEGATE: {
+            expr->type = (u8)check_value(interp, func, expr->binary.left, TYPE_NONE);
+            if (expr->type != TYPE_S64 && expr->type != TYPE_F64) {
+                CompileError(interp, expr->token, "Expressions only work on ints and floats.");
+            }
+            break;
+        }
+        
+        case EXPR_BINARY: {
+            enum Type left = check_value(interp, func, expr->binary.left, TYPE_NONE);
+            enum Type right = check_value(interp, func, expr->binary.right, TYPE_NONE);
+            
+            if (left != right) {
+                CompileError(interp, expr->token, "Expression must have the same type for both operands.");
+            }
+            if (left != TYPE_S64 && left != TYPE_F64) {
+                CompileError(interp, expr->token, "Expressions only work on ints and floats.");
+            }
+            expr->type = (u8)(is_comparison(expr->op) ? TYPE_S64 : left);
+            break;
+        }
+    }
+    
+    Assert(expr->type != TYPE_NONE);
+    return expr->type;
+}
+
+struct Statement *
+statement_new(struct Interpreter *interp, struct Statement ***last, enum Statement_Kind kind, struct Token *token) {
+    struct Statement *statement = arena_alloc(&interp->expr_arena, sizeof(struct Statement));
+    *statement = (struct Statement){0};
+    statement->kind = (u8)kind;
+    statement->token = token;
+    statement->slot = -1;
+    
+    // Append it to the list it's in.
+    **last = statement;
+    *last = &statement->next;
+    
+    return statement;
+}
+
+// "name : type;", "name : *type = value;", "name := value;" or "name = value;"
+void
+typecheck_variable(struct Interpreter *interp, struct Function *func, struct Statement *statement) {
+    struct Token *tok_variable_name = statement->token;
+    struct Token *tok_equals;
+    
+    // The resolver has already given the variable its slot.
+    statement->slot = tok_variable_name->slot;
+    Assert(statement->slot >= 0);
+    
+    enum Type type = func->slot_types[statement->slot];
+    
+    if (statement->kind == STATEMENT_DECLARATION) {
+        struct Token *tok_colon = tok_variable_name + 1;
+        bool is_pointer = tok_colon[1].type == TOKEN_POINTER;
+        
+        if (tok_colon[1].type == TOKEN_EQUAL) {
+            // The type is inferred from the value below. The slot
+            // might have had another type in an earlier block.
+            tok_equals = tok_colon + 1;
+            type = TYPE_NONE;
+        } else {
+            struct Token *tok_type = is_pointer ? tok_colon + 2 : tok_colon + 1;
+            tok_equals = tok_type + 1;
+            type = get_type(tok_type);
+            
+            if (!type) {
+                char name[MAX_TOKEN_LENGTH];
+                CompileError1(interp, tok_type, "%s is not a type.",
+                              token_name(&interp->tokenizer, tok_type, name));
+            }
+            
+            if (type == TYPE_STRING && tok_equals->type != TOKEN_EQUAL) {
+                CompileError(interp, tok_variable_name, "Must initialize a string to something.");
+            }
+        }
+    } else {
+        tok_equals = tok_variable_name + 1;
+    }
+    
+    if (tok_equals->type == TOKEN_EQUAL) {
+        struct Token *tok_value = tok_equals + 1;
+        statement->value = parse_statement_value(interp, &tok_value);
+        type = check_value(interp, func, statement->value, type);
+    }
+    
+    // Other functions read the types of the parameters while this one's
+    // checked, and those never change, so it's only written if it did.
+    if (func->slot_types[statement->slot] != type) {
+        func->slot_types[statement->slot] = type;
+    }
+}
+
+// "return;" or "return value;"
+void
+typecheck_return(struct Interpreter *interp, struct Function *func, struct Statement *statement) {
+    struct Token *tok = statement->token;
+    
+    if (tok[1].type == TOKEN_END_STATEMENT) {
+        if (func->return_type) {
+            CompileError1(interp, tok, "%s() must return a value.", func->name);
+        }
+    } else {
+        if (!func->return_type) {
+            CompileError1(interp, tok, "%s() does not return a value.", func->name);
+        }
+        struct Token *tok_value = tok + 1;
+        statement->value = parse_statement_value(interp, &tok_value);
+        check_value(interp, func, statement->value, func->return_type);
+    }
+}
+
+// Conditions are ints, and anything but 0 is true.
+void
+check_condition(struct Interpreter *interp, struct Function *func, struct Expr *expr) {
+    if (check_value(interp, func, expr, TYPE_NONE) != TYPE_S64) {
+        CompileError(interp, expr->token, "A condition has to be an int.");
+    }
+}
+
+void typecheck_block(struct Interpreter *interp, struct Function *func, struct Token *open, struct Statement ***last);
+
+// "if value {...}", then maybe "else if value {...}" any number
+// of times, and maybe "else {...}" at the end.
+// Returns the token after the last }.
+struct Token *
+typecheck_if(struct Interpreter *interp, struct Function *func, struct Statement *statement) {
+    struct Token *tok = statement->token + 1;
+    statement->value = parse_condition(interp, &tok);
+    check_condition(interp, func, statement->value);
+    
+    struct Statement **body = &statement->body;
+    typecheck_block(interp, func, tok, &body);
+    tok = matching_brace(&interp->tokenizer, tok) + 1;
+    
+    if (tok->type == TOKEN_IDENTIFIER && tok->symbol == SYMBOL_ELSE) {
+        struct Statement **else_body = &statement->else_body;
+        tok++;
+        
+        if (tok->type == TOKEN_IDENTIFIER && tok->symbol == SYMBOL_IF) {
+            return typecheck_if(interp, func, statement_new(interp, &else_body, STATEMENT_IF, tok));
+        }
+        if (tok->type != TOKEN_OPEN_SCOPE) {
+            CompileError(interp, tok, "Expected a { or an if after the else.");
+        }
+        
+        typecheck_block(interp, func, tok, &else_body);
+        tok = matching_brace(&interp->tokenizer, tok) + 1;
+    }
+    
+    return tok;
+}
+
+// "while value {...}"
+// Returns the token after the }.
+struct Token *
+typecheck_while(struct Interpreter *interp, struct Function *func, struct Statement *statement) {
+    struct Token *tok = statement->token + 1;
+    statement->value = parse_condition(interp, &tok);
+    check_condition(interp, func, statement->value);
+    
+    struct Statement **body = &statement->body;
+    typecheck_block(interp, func, tok, &body);
+    
+    return matching_brace(&interp->tokenizer, tok) + 1;
+}
+
+// Appends the statements from tok up to end to *last. The blocks of
+// ifs and whiles become their own lists, but a plain { } block only
+// matters to the resolver, so it's just more statements.
+void
+typecheck_statements(struct Interpreter *interp, struct Function *func, struct Token *tok, struct Token *end, struct Statement ***last) {
+    while (tok < end) {
+        if (tok->type == TOKEN_OPEN_SCOPE) {
+            typecheck_block(interp, func, tok, last);
+            tok = matching_brace(&interp->tokenizer, tok) + 1;
+            continue;
+        }
+        
+        if (tok->type == TOKEN_IDENTIFIER && tok->identifier_type == IDENTIFIER_KEYWORD) {
+            if (tok->symbol == SYMBOL_IF) {
+                tok = typecheck_if(interp, func, statement_new(interp, last, STATEMENT_IF, tok));
+                continue;
+            }
+            if (tok->symbol == SYMBOL_WHILE) {
+                tok = typecheck_while(interp, func, statement_new(interp, last, STATEMENT_WHILE, tok));
+                continue;
+            }
+            if (tok->symbol == SYMBOL_ELSE) {
+                CompileError(interp, tok, "This else doesn't come after an if.");
+            }
+        }
+        
+        // Anything we don't know how to run is an error, rather than
+        // something that's quietly left out.
+        if (tok->type != TOKEN_IDENTIFIER && tok->type != TOKEN_END_STATEMENT) {
+            CompileError(interp, tok, "Expected a statement, like a declaration, an assignment or a call.");
+        }
+        
+        if (tok->type == TOKEN_IDENTIFIER) {
+            switch (tok->identifier_type) {
+                case IDENTIFIER_VARIABLE_OR_TYPE: {
+                    if (tok[1].type == TOKEN_COLON) {
+                        typecheck_variable(interp, func, statement_new(interp, last, STATEMENT_DECLARATION, tok));
+                    } else if (tok[1].type == TOKEN_EQUAL) {
+                        typecheck_variable(interp, func, statement_new(interp, last, STATEMENT_ASSIGNMENT, tok));
+                    } else {
+                        char name[MAX_TOKEN_LENGTH];
+                        CompileError1(interp, tok, "Expected a : or an = after %s, to declare or assign it.",
+                                      token_name(&interp->tokenizer, tok, name));
+                    }
+                    break;
+                }
+                
+                case IDENTIFIER_FUNCTION_CALL: {
+                    struct Statement *statement = statement_new(interp, last, STATEMENT_EXPRESSION, tok);
+                    struct Token *tok_value = tok;
+                    statement->value = parse_statement_value(interp, &tok_value);
+                    
+                    // A lone call can be void, so don't use check_expression().
+                    if (statement->value->kind == EXPR_CALL) {
+                        statement->value->type = (u8)check_call(interp, func, statement->value);
+                    } else {
+                        check_value(interp, func, statement->value, TYPE_NONE);
+                    }
+                    break;
+                }
+                
+                case IDENTIFIER_KEYWORD: {
+                    if (tok->symbol == SYMBOL_RETURN) {
+                        typecheck_return(interp, func, statement_new(interp, last, STATEMENT_RETURN, tok));
+                        break;
+                    }
+                    char name[MAX_TOKEN_LENGTH];
+                    CompileError1(interp, tok, "%s can't start a statement here.",
+                                  token_name(&interp->tokenizer, tok, name));
+                    break;
+                }
+                
+                default: {
+                    CompileError(interp, tok, "Expected a statement, like a declaration, an assignment or a call.");
+                    break;
+                }
+            }
+            
+            skip_to_end_of_statement(&tok);
+            
+            // A { that cut the statement short is still a block.
+            if (tok->type == TOKEN_OPEN_SCOPE) {
+                continue;
+            }
+        }
+        
+        if (tok->type == TOKEN_NONE) break;
+        tok++;
+    }
+}
+
+// Appends the statements between the { at `open` and its } to *last.
+void
+typecheck_block(struct Interpreter *interp, struct Function *func, struct Token *open, struct Statement ***last) {
+    typecheck_statements(interp, func, open + 1, matching_brace(&interp->tokenizer, open), last);
+}
+
+void
+typecheck_function(struct Interpreter *interp, struct Function *func) {
+    struct Statement **last = &func->statements;
+    typecheck_block(interp, func, func->body, &last);
+}
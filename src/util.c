@@ -18,44 +18,203 @@ typedef double f64;
 
 #define Log(...) (printf(__VA_ARGS__), fflush(stdout))
 #define Error(...) fprintf(stderr, __VA_ARGS__)
-#define Assert(cond) if (!(cond)) {Error("Assertion failed at %s(%d)!\n", __FILE__, __LINE__), __debugbreak();}
-#define Panic() Error("Panic at %s(%d)!\n", __FILE__, __LINE__), exit(1)
-#define CompileError(interp, token, message) \
-    (Error("Error: %s(%d)\n  " message "\n", \
-           (interp)->tokenizer.file_name,    \
-           (token)->line),                   \
-           exit(1))
-#define CompileError1(interp, token, message, param1) \
-    (Error("Error: %s(%d)\n  " message "\n", \
-           (interp)->tokenizer.file_name,    \
-           (token)->line,                    \
-           param1),                          \
-           exit(1))
-
-char *
-read_entire_file(const char *file) {
-    HANDLE hFile = CreateFile(
-        file,
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
-
-    DWORD count = GetFileSize(hFile, NULL);
-    DWORD num_read = 0;
-
-    char *out = calloc(1, count+1);
-    memset(out, '^', count+1); // For debugging. If we see any ^'s, we know something has gone wrong.
-
-    bool ok = ReadFile(hFile, out, count, &num_read, NULL);
-    if (!ok) {
-        Panic();
+
+#if defined(_MSC_VER)
+#define Breakpoint() __debugbreak()
+#else
+#define Breakpoint() __builtin_trap()
+#endif
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define ERROR_MESSAGE_SIZE 1024
+
+// Panic() and failed Asserts stop the process, unless whatever's running
+// us on this thread set fatal_handler, like libvaria does. Then the
+// message goes to error_message instead, and we longjmp to on_error,
+// with FATAL_ERROR, so it can tell it from an error in the program.
+struct Fatal_Handler {
+    jmp_buf *on_error;
+    char *error_message; // Holds ERROR_MESSAGE_SIZE chars.
+};
+
+#define FATAL_ERROR 2
+
+THREAD_LOCAL struct Fatal_Handler *fatal_handler;
+
+// Only returns if there's no fatal_handler.
+void
+fatal_error(const char *format, ...) {
+    struct Fatal_Handler *handler = fatal_handler;
+    
+    va_list args;
+    va_start(args, format);
+    if (handler) {
+        vsnprintf(handler->error_message, ERROR_MESSAGE_SIZE, format, args);
+    } else {
+        vfprintf(stderr, format, args);
+    }
+    va_end(args);
+    
+    if (handler) {
+        longjmp(*handler->on_error, FATAL_ERROR);
     }
+}
+
+#define Assert(cond) if (!(cond)) {fatal_error("Assertion failed at %s(%d)!\n", __FILE__, __LINE__), Breakpoint();}
+#define Panic() fatal_error("Panic at %s(%d)!\n", __FILE__, __LINE__), exit(1)
+#define CompileError(interp, token, message)         \
+    tokenizer_error(&(interp)->tokenizer,            \
+                    "Error: %s(%d)\n  " message "\n", \
+                    (interp)->tokenizer.file_name,   \
+                    (token)->line)
+#define CompileError1(interp, token, message, param1) \
+    tokenizer_error(&(interp)->tokenizer,            \
+                    "Error: %s(%d)\n  " message "\n", \
+                    (interp)->tokenizer.file_name,   \
+                    (token)->line,                   \
+                    param1)
+
+// Bump allocated memory that's all thrown away at once, like the
+// expression trees, which only live until the functions are compiled.
+struct Arena_Block {
+    struct Arena_Block *next;
+    u64 size, used;
+    // The memory follows.
+};
+
+struct Arena {
+    struct Arena_Block *first, *current;
+};
 
-    out[count] = 0;
+#define ARENA_BLOCK_SIZE Kilobytes(64)
+
+void *
+arena_alloc(struct Arena *arena, u64 size) {
+    size = (size + 7) & ~(u64)7;
+    
+    struct Arena_Block *block = arena->current;
+    
+    if (!block || block->used + size > block->size) {
+        // Reuse the blocks we had before the last reset, if they fit.
+        if (block && block->next && size <= block->next->size) {
+            block = block->next;
+        } else {
+            u64 block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+            struct Arena_Block *new_block = malloc(sizeof(struct Arena_Block) + block_size);
+            Assert(new_block);
             
-    return out;
+            new_block->size = block_size;
+            new_block->next = block ? block->next : NULL;
+            if (block) {
+                block->next = new_block;
+            } else {
+                arena->first = new_block;
+            }
+            block = new_block;
+        }
+        
+        block->used = 0;
+        arena->current = block;
+    }
+    
+    void *result = (u8*)(block + 1) + block->used;
+    block->used += size;
+    return result;
+}
+
+// Frees everything allocated so far, but keeps the memory around.
+void
+arena_reset(struct Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+}
+
+// Moves all of from's memory over to arena without copying it, so
+// whatever was allocated from it stays where it is, and is freed
+// along with arena.
+void
+arena_take(struct Arena *arena, struct Arena *from) {
+    if (!from->first) return;
+    
+    if (!arena->first) {
+        *arena = *from;
+    } else {
+        // Goes in just after what's in use, so the blocks after that
+        // can still be reused.
+        struct Arena_Block *last = from->first;
+        while (last->next) last = last->next;
+        
+        last->next = arena->current->next;
+        arena->current->next = from->first;
+        arena->current = from->current;
+    }
+    
+    *from = (struct Arena){0};
+}
+
+void
+arena_free(struct Arena *arena) {
+    struct Arena_Block *block = arena->first;
+    while (block) {
+        struct Arena_Block *next = block->next;
+        free(block);
+        block = next;
+    }
+    *arena = (struct Arena){0};
+}
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+int
+count_bits(u32 x) {
+    return (int)__popcnt(x);
+}
+
+// x must not be 0.
+int
+first_set_bit(u32 x) {
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int)index;
+}
+#else
+int
+count_bits(u32 x) {
+    return __builtin_popcount(x);
+}
+
+// x must not be 0.
+int
+first_set_bit(u32 x) {
+    return __builtin_ctz(x);
+}
+#endif
+
+// A size like "512M", with an optional K, M, G or T suffix.
+// Returns 0 if it isn't one.
+u64
+parse_size(const char *text) {
+    char *end;
+    u64 size = strtoull(text, &end, 10);
+    if (end == text || size == UINT64_MAX) return 0;
+    
+    u64 unit = 1;
+    switch (*end) {
+        case 'k': case 'K': unit = Kilobytes(1); end++; break;
+        case 'm': case 'M': unit = Megabytes(1); end++; break;
+        case 'g': case 'G': unit = Gigabytes(1); end++; break;
+        case 't': case 'T': unit = Terabytes(1); end++; break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    
+    if (*end || size > UINT64_MAX / unit) return 0;
+    return size * unit;
 }
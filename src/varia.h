@@ -0,0 +1,70 @@
+// libvaria: runs Varia programs from inside another program, without
+// starting a process for each one. Build it with build_lib.sh (or
+// build_lib.bat), include this file, and link with libvaria.
+//
+//     struct Varia *varia = varia_create(NULL);
+//     if (!varia_load(varia, "script.v", source, length) || !varia_run(varia)) {
+//         fprintf(stderr, "%s", varia_error(varia));
+//     }
+//     varia_destroy(varia);
+//
+// Nothing is shared between interpreters, so any number of them can be
+// used at once, as long as each one is only used by one thread at a time.
+
+#ifndef VARIA_H
+#define VARIA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(VARIA_DLL_EXPORT)
+#define VARIA_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define VARIA_API __attribute__((visibility("default")))
+#else
+#define VARIA_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Varia;
+
+struct Varia_Options {
+    // Where print() goes, in pieces of up to 64KB. NULL for stdout.
+    void (*write)(void *write_data, const char *text, uint64_t size);
+    void *write_data;
+
+    bool no_jit; // Interpret everything, even where there's a JIT.
+
+    // The address space each program's stack can use, at least 8MB.
+    // 0 for 256MB. It's only backed by memory as the stack grows.
+    uint64_t heap_size;
+    bool huge_pages; // Ask for transparent huge pages for it.
+};
+
+// options can be NULL for the defaults.
+// Returns NULL if there isn't enough memory.
+VARIA_API struct Varia *varia_create(const struct Varia_Options *options);
+
+// Tokenizes, checks and compiles a program, replacing the one that was
+// loaded before, if there was one. The source is copied, and name is
+// only used in error messages. Returns false if there's an error.
+VARIA_API bool varia_load(struct Varia *varia, const char *name, const char *source, size_t length);
+
+// Runs main() of the loaded program. It can be run again afterwards,
+// even after an error. Returns false if there's an error.
+VARIA_API bool varia_run(struct Varia *varia);
+
+// The error from the last varia_load() or varia_run() that failed.
+VARIA_API const char *varia_error(struct Varia *varia);
+
+VARIA_API void varia_destroy(struct Varia *varia);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,322 @@
+void
+print_value(struct Output *output, enum Type type, union Value value) {
+    switch (type) {
+        case TYPE_STRING: {
+            u64 length;
+            const char *data = string_data(&value, &length);
+            output_write(output, data, length);
+            break;
+        }
+        
+        case TYPE_U8: {
+            output_write(output, (char*)&value.u8, 1);
+            break;
+        }
+        
+        case TYPE_S64: {
+            output_s64(output, value.s64);
+            output_write(output, "\n", 1);
+            break;
+        }
+        
+        case TYPE_F64: {
+            output_f64(output, value.f64);
+            output_write(output, "\n", 1);
+            break;
+        }
+    }
+}
+
+// print() doesn't get a frame, but it's still a call as far as the profiler's concerned.
+void
+vm_print(struct Program *program, struct Profiler *profiler, enum Type type, union Value value) {
+    if (profiler) {
+        profile_enter(profiler, profiler->print_function);
+    }
+    
+    print_value(&program->output, type, value);
+    
+    if (profiler) {
+        profile_leave(profiler);
+    }
+}
+
+// Stops the program after a runtime error has been reported.
+void
+vm_fail(struct Program *program) {
+    if (program->on_error) {
+        longjmp(*program->on_error, 1);
+    }
+    exit(1);
+}
+
+// Reports a runtime error, then stops. Doesn't return.
+void
+program_error(struct Program *program, const char *format, ...) {
+    // Whatever was printed before still shows up.
+    output_flush(&program->output);
+    
+    va_list args;
+    va_start(args, format);
+    if (program->error_message) {
+        vsnprintf(program->error_message, ERROR_MESSAGE_SIZE, format, args);
+    } else {
+        vfprintf(stderr, format, args);
+    }
+    va_end(args);
+    
+    vm_fail(program);
+}
+
+// Forgets the calls that were running when an error stopped the
+// program, so it can be run again.
+void
+vm_reset(struct Program *program) {
+    program->call_stack_count = 0;
+    program->native_depth = 0;
+    program->current_function = NULL;
+}
+
+void
+vm_division_by_zero(struct Program *program) {
+    program_error(program, "Division by zero in %s()!\n", program->current_function->name);
+}
+
+// Commits the heap up to at least end, a whole step at a time so it's
+// rarely done, but never into the guard. Returns false if we're out of memory.
+bool
+program_commit_memory(struct Program *program, u8 *end) {
+    u64 step_mask = HEAP_COMMIT_STEP-1;
+    u8 *committed = program->memory + (((u64)(end - program->memory) + step_mask) & ~step_mask);
+    if (committed > (u8*)program->stack_end) {
+        committed = (u8*)program->stack_end;
+    }
+    
+    if (!platform_commit_memory(program->memory_committed, (u64)(committed - program->memory_committed))) {
+        return false;
+    }
+    program->memory_committed = committed;
+    return true;
+}
+
+// Checks that a frame for `function` starting at `frame` fits on the
+// stack, and commits the memory for it if it hasn't been already.
+// Keeps track of how far up the stack frames have reached, too.
+void
+vm_check_stack(struct Program *program, struct Function *function, union Value *frame) {
+    union Value *top = frame + function->slot_count + function->bytecode.max_depth;
+    
+    if (program->call_stack_count + program->native_depth >= MAX_CALL_DEPTH ||
+        top > program->stack_end)
+    {
+        program_error(program, "Stack overflow in %s()!\n", function->name);
+    }
+    
+    // Everything below the peak's already committed.
+    if (top > program->stack_peak) {
+        if ((u8*)top > program->memory_committed && !program_commit_memory(program, (u8*)top)) {
+            program_error(program, "Out of memory in %s()!\n", function->name);
+        }
+        program->stack_peak = top;
+    }
+}
+
+Jit_Function *jit_lookup(struct Program *program, struct Function *function);
+void vm_run(struct Program *program, struct Function *function, union Value *frame);
+
+// Runs the function until it returns, as native code if the JIT has
+// compiled it. Its arguments have to be in place at the start of frame.
+void
+vm_call(struct Program *program, struct Function *function, union Value *frame) {
+    vm_check_stack(program, function, frame);
+    
+    struct Profiler *profiler = program->profiler;
+    if (profiler) {
+        profile_enter(profiler, (int)(function - program->functions));
+    }
+    
+    struct Function *caller = program->current_function;
+    program->current_function = function;
+    
+    Jit_Function *native = NULL;
+    if (program->native_depth < JIT_MAX_NATIVE_DEPTH) {
+        native = jit_lookup(program, function);
+    }
+    
+    program->native_depth++;
+    if (native) {
+        native(frame, program);
+    } else {
+        vm_run(program, function, frame);
+    }
+    program->native_depth--;
+    
+    program->current_function = caller;
+    
+    if (profiler) {
+        profile_leave(profiler);
+    }
+}
+
+// Interprets the bytecode of `function` until it returns. Calls to
+// functions that aren't compiled stay in here, on program.call_stack.
+// Use vm_call() to start it, not this.
+void
+vm_run(struct Program *program, struct Function *function, union Value *frame) {
+    // The locals come right after the arguments, so reserve them.
+    union Value *sp = frame + function->slot_count; // Points to the next free element.
+
+    struct Instruction *ip = function->bytecode.code;
+
+    // We return once the calls made in here have all returned.
+    int base_call_stack_count = program->call_stack_count;
+    
+    // Kept in a local so checking it costs next to nothing without --profile.
+    struct Profiler *profiler = program->profiler;
+
+    for (;;) {
+        struct Instruction *instruction = ip++;
+
+        switch (instruction->op) {
+            case OP_PUSH: {
+                *sp++ = instruction->imm;
+                break;
+            }
+            case OP_LOAD: {
+                *sp++ = frame[instruction->operand];
+                break;
+            }
+            case OP_STORE: {
+                frame[instruction->operand] = *--sp;
+                break;
+            }
+            case OP_POP: {
+                sp--;
+                break;
+            }
+            case OP_STATEMENT: {
+                program->statements_run++;
+                break;
+            }
+
+            // Ints wrap when they overflow, like they do when they're folded,
+            // so these go through u64, where that's defined.
+            case OP_ADD_S64:      sp--; sp[-1].s64 = (s64)((u64)sp[-1].s64 + (u64)sp[0].s64); break;
+            case OP_SUBTRACT_S64: sp--; sp[-1].s64 = (s64)((u64)sp[-1].s64 - (u64)sp[0].s64); break;
+            case OP_MULTIPLY_S64: sp--; sp[-1].s64 = (s64)((u64)sp[-1].s64 * (u64)sp[0].s64); break;
+            case OP_DIVIDE_S64: {
+                sp--;
+                if (sp[0].s64 == 0) {
+                    vm_division_by_zero(program);
+                }
+                if (sp[0].s64 == -1) {
+                    // INT64_MIN / -1 traps, so negate it instead, which wraps.
+                    sp[-1].s64 = (s64)(0 - (u64)sp[-1].s64);
+                } else {
+                    sp[-1].s64 /= sp[0].s64;
+                }
+                break;
+            }
+
+            case OP_ADD_F64:      sp--; sp[-1].f64 += sp[0].f64; break;
+            case OP_SUBTRACT_F64: sp--; sp[-1].f64 -= sp[0].f64; break;
+            case OP_MULTIPLY_F64: sp--; sp[-1].f64 *= sp[0].f64; break;
+            case OP_DIVIDE_F64:   sp--; sp[-1].f64 /= sp[0].f64; break;
+
+            case OP_NEGATE_S64:   sp[-1].s64 = (s64)(0 - (u64)sp[-1].s64); break;
+            case OP_NEGATE_F64:   sp[-1].f64 = -sp[-1].f64; break;
+
+            case OP_EQUAL_S64:         sp--; sp[-1].s64 = sp[-1].s64 == sp[0].s64; break;
+            case OP_NOT_EQUAL_S64:     sp--; sp[-1].s64 = sp[-1].s64 != sp[0].s64; break;
+            case OP_LESS_S64:          sp--; sp[-1].s64 = sp[-1].s64 <  sp[0].s64; break;
+            case OP_LESS_EQUAL_S64:    sp--; sp[-1].s64 = sp[-1].s64 <= sp[0].s64; break;
+            case OP_GREATER_S64:       sp--; sp[-1].s64 = sp[-1].s64 >  sp[0].s64; break;
+            case OP_GREATER_EQUAL_S64: sp--; sp[-1].s64 = sp[-1].s64 >= sp[0].s64; break;
+
+            case OP_EQUAL_F64:         sp--; sp[-1].s64 = sp[-1].f64 == sp[0].f64; break;
+            case OP_NOT_EQUAL_F64:     sp--; sp[-1].s64 = sp[-1].f64 != sp[0].f64; break;
+            case OP_LESS_F64:          sp--; sp[-1].s64 = sp[-1].f64 <  sp[0].f64; break;
+            case OP_LESS_EQUAL_F64:    sp--; sp[-1].s64 = sp[-1].f64 <= sp[0].f64; break;
+            case OP_GREATER_F64:       sp--; sp[-1].s64 = sp[-1].f64 >  sp[0].f64; break;
+            case OP_GREATER_EQUAL_F64: sp--; sp[-1].s64 = sp[-1].f64 >= sp[0].f64; break;
+
+            case OP_JUMP: {
+                ip += instruction->operand;
+                break;
+            }
+            case OP_JUMP_IF_ZERO: {
+                if ((--sp)->s64 == 0) {
+                    ip += instruction->operand;
+                }
+                break;
+            }
+
+            case OP_CALL: {
+                struct Function *callee = &program->functions[instruction->operand];
+                
+                // The arguments are already in place as the first slots.
+                union Value *callee_frame = sp - callee->parameter_count;
+                
+                if (program->native_depth < JIT_MAX_NATIVE_DEPTH && jit_lookup(program, callee)) {
+                    vm_call(program, callee, callee_frame);
+                    sp = callee_frame + (callee->return_type ? 1 : 0);
+                    break;
+                }
+                
+                vm_check_stack(program, callee, callee_frame);
+
+                program->call_stack[program->call_stack_count++] = (struct Position){
+                    ip,
+                    program->current_function,
+                    frame
+                };
+
+                if (profiler) {
+                    profile_enter(profiler, instruction->operand);
+                }
+                
+                program->current_function = callee;
+                ip = callee->bytecode.code;
+                frame = callee_frame;
+                sp = frame + callee->slot_count;
+                break;
+            }
+
+            case OP_PRINT_U8:     vm_print(program, profiler, TYPE_U8, *--sp); break;
+            case OP_PRINT_S64:    vm_print(program, profiler, TYPE_S64, *--sp); break;
+            case OP_PRINT_F64:    vm_print(program, profiler, TYPE_F64, *--sp); break;
+            case OP_PRINT_STRING: vm_print(program, profiler, TYPE_STRING, *--sp); break;
+
+            case OP_RETURN:
+            case OP_RETURN_VALUE: {
+                // Throw away the frame, leaving the return
+                // value where the first argument was.
+                if (instruction->op == OP_RETURN_VALUE) {
+                    frame[0] = sp[-1];
+                    sp = frame + 1;
+                } else {
+                    sp = frame;
+                }
+                
+                if (program->call_stack_count == base_call_stack_count) {
+                    return;
+                }
+                
+                if (profiler) {
+                    profile_leave(profiler);
+                }
+
+                struct Position pos = program->call_stack[--program->call_stack_count];
+                ip = pos.ip;
+                program->current_function = pos.func;
+                frame = pos.frame;
+                break;
+            }
+
+            default: {
+                program_error(program, "Unknown instruction %d in %s()!\n",
+                              instruction->op, program->current_function->name);
+            }
+        }
+    }
+}
@@ -1,5 +1,50 @@
 @echo off
 pushd bin\
 varia test.c
+if errorlevel 1 goto done
+
+rem Each program in tests\ has to print exactly what's in its .out file,
+rem interpreted and from its cache. There's no JIT on Windows.
+set failed=0
+for %%p in (tests\*.v) do (
+    del /q %%p.vcache 2>nul
+    call :check %%p --no-jit "--no-jit"
+    call :check %%p "" "the first run"
+    call :check %%p "" "the cache"
+    del /q %%p.vcache 2>nul
+)
+
+rem Each program in tests\errors\ has to fail with exactly the error in
+rem its .out file. They're run from in there, so the errors have the same
+rem file name everywhere.
+pushd tests\errors\
+for %%p in (*.v) do (
+    ..\..\varia %%p --no-cache > "%TEMP%\varia_test.txt" 2>&1
+    if not errorlevel 1 (
+        echo %%p didn't fail
+        set failed=1
+    )
+    fc "%TEMP%\varia_test.txt" "%%~np.out" > nul
+    if errorlevel 1 (
+        echo %%p printed the wrong error
+        set failed=1
+    )
+)
 popd
-exit %errorlevel%
\ No newline at end of file
+
+if %failed%==0 echo All the tests passed.
+popd
+exit /b %failed%
+
+:check
+varia %1 %~2 > "%TEMP%\varia_test.txt" 2>&1
+fc "%TEMP%\varia_test.txt" "%~dpn1.out" > nul
+if errorlevel 1 (
+    echo %1 doesn't match with %~3
+    set failed=1
+)
+exit /b
+
+:done
+popd
+exit /b 1
@@ -0,0 +1,193 @@
+#!/bin/sh
+
+cd bin/ || exit 1
+./varia test.c || exit 1
+
+out=$(mktemp -d) || exit 1
+trap 'rm -rf "$out"' EXIT
+failed=0
+
+# Fails unless $out/output is exactly the file $1. $2 says what made it.
+check() {
+    if ! cmp -s "$1" "$out/output"; then
+        echo "$2 printed the wrong thing:"
+        diff "$1" "$out/output" | head -20
+        failed=1
+    fi
+}
+
+# The same, but with what it should be, plus a newline, in $1.
+check_text() {
+    printf '%s\n' "$1" > "$out/expected"
+    check "$out/expected" "$2"
+}
+
+# Each program in tests/ has to print exactly what's in its .out file,
+# interpreted, through the JIT, from its cache and built from --emit-c.
+for program in tests/*.v; do
+    expected="${program%.v}.out"
+    rm -f "$program.vcache"
+
+    ./varia "$program" --no-jit > "$out/output" 2>&1
+    check "$expected" "$program with --no-jit"
+
+    ./varia "$program" > "$out/output" 2>&1
+    check "$expected" "$program with the JIT"
+
+    if [ ! -f "$program.vcache" ]; then
+        echo "$program wasn't cached"
+        failed=1
+    fi
+    ./varia "$program" > "$out/output" 2>&1
+    check "$expected" "$program from its cache"
+
+    if ./varia "$program" --no-cache --emit-c="$out/program.c" &&
+       ${CC:-cc} -O2 "$out/program.c" -o "$out/program" -lm; then
+        "$out/program" > "$out/output" 2>&1
+    else
+        echo "(--emit-c didn't build)" > "$out/output"
+    fi
+    check "$expected" "$program from --emit-c"
+
+    rm -f "$program.vcache"
+done
+
+# Each program in tests/errors/ has to fail with exactly the error in
+# its .out file. They're run from in there, so the errors have the same
+# file name everywhere.
+for program in tests/errors/*.v; do
+    name="${program##*/}"
+    if (cd tests/errors && ../../varia "$name" --no-cache > "$out/output" 2>&1); then
+        echo "$program didn't fail"
+        failed=1
+    fi
+    check "${program%.v}.out" "$program"
+done
+
+# Each input in tests/repl/ is typed into --repl, which has to print
+# exactly what's in its .out file.
+for input in tests/repl/*.in; do
+    ./varia --repl < "$input" > "$out/output" 2>&1
+    check "${input%.in}.out" "$input"
+done
+
+# --profile's call counts, and the call stacks it writes for flame
+# graphs, have to be exactly what's in .counts and .stacks. The times
+# change from run to run, so they're left out, and the rows are sorted.
+for program in tests/profile/*.v; do
+    for jit in --no-jit ""; do
+        ./varia "$program" --no-cache $jit --profile="$out/folded" 2> "$out/report" > /dev/null
+        awk 'NF == 4 { print $1, $2 } NF == 3 { print }' "$out/report" | LC_ALL=C sort > "$out/output"
+        check "${program%.v}.counts" "$program's call counts $jit"
+        cut -d' ' -f1 "$out/folded" | LC_ALL=C sort > "$out/output"
+        check "${program%.v}.stacks" "$program's call stacks $jit"
+    done
+done
+
+# The stack lives in the heap, and running off the end of it is an error,
+# not a crash, however big the heap is. It can't be smaller than 8MB.
+for jit in --no-jit ""; do
+    ./varia tests/heap/deep.v --no-cache $jit > "$out/output" 2>&1
+    check_text 60000 "tests/heap/deep.v $jit"
+    if ./varia tests/heap/deep.v --no-cache $jit --heap=8M > "$out/output" 2>&1; then
+        echo "tests/heap/deep.v $jit didn't fail with --heap=8M"
+        failed=1
+    fi
+    check_text "Stack overflow in down()!" "tests/heap/deep.v $jit with --heap=8M"
+done
+./varia tests/heap/deep.v --no-cache --heap=1M > "$out/output" 2>&1
+check_text "The heap has to be at least 8MB!" "--heap=1M"
+./varia tests/heap/deep.v --no-cache --huge-pages > "$out/output" 2>&1
+check_text 60000 "tests/heap/deep.v with --huge-pages"
+
+# Programs can have any number of functions, and with this many, they're
+# set up, resolved, type checked and compiled on the thread pool.
+awk 'BEGIN {
+    print "f0 :: (n: int) -> int { return n; }"
+    for (i = 1; i < 3000; i++) printf "f%d :: (n: int) -> int { return f%d(n) + %d; }\n", i, i-1, i
+    print "main :: () { print(f2999(0)); }"
+}' > "$out/functions.v"
+for jit in --no-jit ""; do
+    ./varia "$out/functions.v" --no-cache $jit > "$out/output" 2>&1
+    check_text 4498500 "3000 functions $jit"
+done
+
+# Sources over 1MB are tokenized in chunks on every thread, which has to
+# make exactly the same tokens, down to the byte in the cache, as one
+# thread does. The comments and strings have braces and quotes in them,
+# so chunks that start inside one are caught.
+awk 'BEGIN {
+    print "g0 :: (n: int) -> int { return n; }"
+    for (i = 1; i < 8000; i++) {
+        printf "// g%d adds %d, with a { and a \" in this comment.\n", i, i % 7
+        printf "g%d :: (n: int) -> int {\n    s := \"}{ in a string %d\";\n", i, i
+        printf "    x := %d.5 * 2.0;\n    return g%d(n) + %d;\n}\n", i, i-1, i % 7
+    }
+    print "main :: () { print(\"done \"); print(g7999(0)); }"
+}' > "$out/big.v"
+for threads in 1 8; do
+    rm -f "$out/big.v.vcache"
+    ./varia "$out/big.v" --threads=$threads > "$out/output" 2>&1
+    check_text "done 23997" "a big program on $threads threads"
+    mv "$out/big.v.vcache" "$out/big$threads.vcache"
+done
+if ! cmp -s "$out/big1.vcache" "$out/big8.vcache"; then
+    echo "A big program was tokenized differently on 1 thread and on 8"
+    failed=1
+fi
+
+# A cache is only used if it's whole and was made from the same source.
+# Anything else has to be tokenized again, and give the same output.
+cp tests/control_flow.v "$out/cached.v"
+./varia "$out/cached.v" > /dev/null 2>&1
+cp "$out/cached.v.vcache" "$out/good.vcache"
+size=$(wc -c < "$out/good.vcache")
+
+for cut in 16 100 $((size/2)) $((size-8)); do
+    head -c $cut "$out/good.vcache" > "$out/cached.v.vcache"
+    ./varia "$out/cached.v" > "$out/output" 2>&1
+    check tests/control_flow.out "a cache cut down to $cut bytes"
+done
+for byte in 000 377; do
+    { head -c 128 "$out/good.vcache"; head -c $((size-128)) /dev/zero | tr '\000' "\\$byte"; } > "$out/cached.v.vcache"
+    ./varia "$out/cached.v" > "$out/output" 2>&1
+    check tests/control_flow.out "a cache that's all octal $byte after its header"
+done
+
+# The same length, so only the hash can tell.
+sed 's/triangle(1000)/triangle(2000)/' tests/control_flow.v > "$out/cached.v"
+./varia "$out/cached.v" --no-cache > "$out/changed.out" 2>&1
+cp "$out/good.vcache" "$out/cached.v.vcache"
+./varia "$out/cached.v" > "$out/output" 2>&1
+check "$out/changed.out" "a cache of a source that's changed"
+
+# Runs saving the same cache at once don't get in each other's way.
+rm -f "$out/cached.v.vcache"
+for i in 1 2 3 4; do
+    ./varia "$out/cached.v" > "$out/output$i" 2>&1 &
+done
+wait
+for i in 1 2 3 4; do
+    mv "$out/output$i" "$out/output"
+    check "$out/changed.out" "run $i of 4 at once"
+done
+./varia "$out/cached.v" > "$out/output" 2>&1
+check "$out/changed.out" "the cache saved by 4 runs at once"
+if ls "$out"/*.tmp > /dev/null 2>&1; then
+    echo "Saving the cache left a .tmp file behind"
+    failed=1
+fi
+
+# libvaria returns errors instead of exiting, and keeps working after them.
+if ${CC:-cc} -std=gnu11 -g -fsanitize=address -pthread -I../src tests/libvaria_test.c ../src/libvaria.c \
+       -o "$out/libvaria_test" -lm; then
+    "$out/libvaria_test" || failed=1
+else
+    echo "tests/libvaria_test.c didn't build"
+    failed=1
+fi
+
+if [ $failed != 0 ]; then
+    exit 1
+fi
+echo "All the tests passed."